@@ -0,0 +1,648 @@
+/**
+ * This file is part of CCL which is licensed under
+ * the MIT license (See LICENSE)
+ * github.com/univrsal/ccl
+ */
+
+#include "ccl.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+   Throughput benchmark for CCL
+   Generates synthetic configs with a mix of all value types and measures
+   loading, writing, typed getters/setters (hits and misses) and inserting
+   nodes. Results are printed as CSV (default) or JSON so they can be
+   compared between commits.
+
+   Usage: ccl_bench [--sizes 1000,10000,...] [--reps n] [--seed n]
+                    [--format csv|json] [--out file] [--dir path]
+*/
+
+struct bench_result
+{
+    std::string name;
+    size_t keys = 0;
+    size_t ops = 0;
+    double seconds = 0;
+    size_t bytes = 0;
+};
+
+struct bench_options
+{
+    std::vector<size_t> sizes = { 1000, 10000, 100000, 1000000 };
+    int reps = 3;
+    unsigned seed = 1337;
+    bool json = false;
+    std::string out;
+    std::string dir;
+};
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(const bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+/* Deterministic mix of types, roughly what real configs look like */
+static data_type pick_type(std::mt19937& rng)
+{
+    const auto r = rng() % 100;
+    if (r < 35)
+        return ccl_type_int;
+    if (r < 60)
+        return ccl_type_string;
+    if (r < 75)
+        return ccl_type_bool;
+    if (r < 85)
+        return ccl_type_float;
+    if (r < 88)
+        return ccl_type_int64;
+    if (r < 90)
+        return ccl_type_double;
+    if (r < 94)
+        return ccl_type_point;
+    if (r < 97)
+        return ccl_type_rect;
+    if (r < 99)
+        return ccl_type_int_array;
+    return ccl_type_float_array;
+}
+
+static std::string key_name(const size_t i)
+{
+    return "section" + std::to_string(i % 64) + ".key_" + std::to_string(i);
+}
+
+/* Writes a config with n keys and returns the types of all keys */
+static std::vector<data_type> generate(const std::string& path, const size_t n,
+    const unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<data_type> types;
+    types.reserve(n);
+
+    const auto f = fopen(path.c_str(), "wb");
+    if (!f)
+        return types;
+
+    fprintf(f, "# benchmark config\n");
+    for (size_t i = 0; i < n; i++)
+    {
+        const auto type = pick_type(rng);
+        types.push_back(type);
+
+        if (rng() % 4 == 0)
+            fprintf(f, "# Comment for value %zu\n", i);
+
+        fprintf(f, "%i_%s=", type, key_name(i).c_str());
+        switch (type)
+        {
+        case ccl_type_int:
+            fprintf(f, "%i\n", static_cast<int>(rng() % 200000) - 100000);
+            break;
+        case ccl_type_string:
+            if (rng() % 10 == 0)
+                fprintf(f, "Line one\\nLine two %u\n", static_cast<unsigned>(rng() % 1000));
+            else
+                fprintf(f, "Some string value %u\n", static_cast<unsigned>(rng() % 1000));
+            break;
+        case ccl_type_bool:
+            fprintf(f, "%u\n", static_cast<unsigned>(rng() % 2));
+            break;
+        case ccl_type_float:
+            fprintf(f, "%f\n", (rng() % 100000) / 97.f);
+            break;
+        case ccl_type_int64:
+            fprintf(f, "%llu\n", static_cast<unsigned long long>(rng()) << 24);
+            break;
+        case ccl_type_double:
+            fprintf(f, "%.17g\n", (rng() % 100000) / 97.0);
+            break;
+        case ccl_type_point:
+            fprintf(f, "%u,%u\n", static_cast<unsigned>(rng() % 1920),
+                static_cast<unsigned>(rng() % 1080));
+            break;
+        case ccl_type_rect:
+            fprintf(f, "%u,%u,%u,%u\n", static_cast<unsigned>(rng() % 1920),
+                static_cast<unsigned>(rng() % 1080), static_cast<unsigned>(rng() % 1920),
+                static_cast<unsigned>(rng() % 1080));
+            break;
+        case ccl_type_int_array:
+            /* Lookup table like a gamma curve */
+            for (auto j = 0; j < 32; j++)
+                fprintf(f, j > 0 ? ",%u" : "%u", static_cast<unsigned>(rng() % 65536));
+            fprintf(f, "\n");
+            break;
+        default:
+            for (auto j = 0; j < 16; j++)
+                fprintf(f, j > 0 ? ",%f" : "%f", (rng() % 100000) / 97.f);
+            fprintf(f, "\n");
+        }
+    }
+    fclose(f);
+    return types;
+}
+
+static size_t file_size(const std::string& path)
+{
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : static_cast<size_t>(size);
+}
+
+/* Reads every key once with the getter matching its type */
+template <class T>
+static size_t read_all(T& cfg, const std::vector<data_type>& types,
+    const std::vector<std::string>& keys)
+{
+    size_t sum = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        switch (types[i])
+        {
+        case ccl_type_int:
+            sum += cfg.get_int(keys[i]);
+            break;
+        case ccl_type_string:
+            sum += cfg.get_string(keys[i]).length();
+            break;
+        case ccl_type_bool:
+            sum += cfg.get_bool(keys[i]);
+            break;
+        case ccl_type_float:
+            sum += static_cast<size_t>(cfg.get_float(keys[i]));
+            break;
+        case ccl_type_int64:
+            sum += static_cast<size_t>(cfg.get_int64(keys[i]));
+            break;
+        case ccl_type_double:
+            sum += static_cast<size_t>(cfg.get_double(keys[i]));
+            break;
+        case ccl_type_point:
+            sum += cfg.get_point(keys[i]).x;
+            break;
+        case ccl_type_rect:
+            sum += cfg.get_rect(keys[i]).w;
+            break;
+        case ccl_type_int_array:
+            sum += cfg.get_int_array(keys[i]).size();
+            break;
+        default:
+            sum += cfg.get_float_array(keys[i]).size();
+        }
+    }
+    return sum;
+}
+
+static const std::vector<int> int_array(32, 7);
+static const std::vector<float> float_array(16, 0.5f);
+
+static void write_all(ccl_config& cfg, const std::vector<data_type>& types,
+    const std::vector<std::string>& keys)
+{
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        const auto v = static_cast<int>(i);
+        switch (types[i])
+        {
+        case ccl_type_int:
+            cfg.set_int(keys[i], v);
+            break;
+        case ccl_type_string:
+            cfg.set_string(keys[i], "updated");
+            break;
+        case ccl_type_bool:
+            cfg.set_bool(keys[i], v % 2 == 0);
+            break;
+        case ccl_type_float:
+            cfg.set_float(keys[i], v * 0.5f);
+            break;
+        case ccl_type_int64:
+            cfg.set_int64(keys[i], static_cast<int64_t>(v) << 32);
+            break;
+        case ccl_type_double:
+            cfg.set_double(keys[i], v * 0.25);
+            break;
+        case ccl_type_point:
+            cfg.set_point(keys[i], v, -v);
+            break;
+        case ccl_type_rect:
+            cfg.set_rect(keys[i], v, -v, v, -v);
+            break;
+        case ccl_type_int_array:
+            cfg.set_int_array(keys[i], int_array);
+            break;
+        default:
+            cfg.set_float_array(keys[i], float_array);
+        }
+    }
+}
+
+static void add_all(ccl_config& cfg, const std::vector<data_type>& types,
+    const std::vector<std::string>& keys)
+{
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        const auto v = static_cast<int>(i);
+        switch (types[i])
+        {
+        case ccl_type_int:
+            cfg.add_int(keys[i], "Added integer", v);
+            break;
+        case ccl_type_string:
+            cfg.add_string(keys[i], "Added string", "value");
+            break;
+        case ccl_type_bool:
+            cfg.add_bool(keys[i], "Added bool", v % 2 == 0);
+            break;
+        case ccl_type_float:
+            cfg.add_float(keys[i], "Added float", v * 0.5f);
+            break;
+        case ccl_type_int64:
+            cfg.add_int64(keys[i], "Added int64", static_cast<int64_t>(v) << 32);
+            break;
+        case ccl_type_double:
+            cfg.add_double(keys[i], "Added double", v * 0.25);
+            break;
+        case ccl_type_point:
+            cfg.add_point(keys[i], "Added point", v, -v);
+            break;
+        case ccl_type_rect:
+            cfg.add_rect(keys[i], "Added rect", v, -v, v, -v);
+            break;
+        case ccl_type_int_array:
+            cfg.add_int_array(keys[i], "Added int array", int_array);
+            break;
+        default:
+            cfg.add_float_array(keys[i], "Added float array", float_array);
+        }
+    }
+}
+
+static void run(const bench_options& opt, const size_t n, std::vector<bench_result>& results)
+{
+    const auto path = opt.dir + "/ccl_bench_" + std::to_string(n) + ".ini";
+    const auto out_path = path + ".out";
+    const auto types = generate(path, n, opt.seed);
+    const auto bytes = file_size(path);
+
+    std::vector<std::string> keys, missing;
+    keys.reserve(n);
+    missing.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        keys.push_back(key_name(i));
+        missing.push_back("missing." + std::to_string(i));
+    }
+
+    /* Keep the best run of each benchmark */
+    auto best = [&](const char* name, const size_t ops, const size_t b, auto&& fn)
+    {
+        bench_result r;
+        r.name = name;
+        r.keys = n;
+        r.ops = ops;
+        r.bytes = b;
+        r.seconds = 1e300;
+        for (auto i = 0; i < opt.reps; i++)
+        {
+            const auto t = fn();
+            if (t < r.seconds)
+                r.seconds = t;
+        }
+        results.push_back(r);
+    };
+
+    volatile size_t sink = 0;
+
+    best("load", n, bytes, [&]
+    {
+        const auto start = bench_clock::now();
+        ccl_config cfg(path, "");
+        return seconds_since(start);
+    });
+
+    best("load_mapped", n, bytes, [&]
+    {
+        const auto start = bench_clock::now();
+        ccl_config cfg(path, "", ccl_load_mapped);
+        return seconds_since(start);
+    });
+
+    best("load_parallel", n, bytes, [&]
+    {
+        const auto start = bench_clock::now();
+        ccl_config cfg(path, "", ccl_load_mapped | ccl_load_parallel);
+        return seconds_since(start);
+    });
+
+    best("stream_scan", n, bytes, [&]
+    {
+        const auto start = bench_clock::now();
+        ccl_parser parser;
+        size_t entries = 0;
+        parser.parse_file(path, [&](const ccl_entry&) { entries++; });
+        sink = sink + entries;
+        return seconds_since(start);
+    });
+
+    best("load_lazy", n, bytes, [&]
+    {
+        const auto start = bench_clock::now();
+        ccl_config cfg(path, "", ccl_load_mapped | ccl_load_lazy);
+        return seconds_since(start);
+    });
+
+    best("load_no_comments", n, bytes, [&]
+    {
+        const auto start = bench_clock::now();
+        ccl_config cfg(path, "", ccl_load_mapped | ccl_load_no_comments);
+        return seconds_since(start);
+    });
+
+    /* One array value with an element per key */
+    std::string elements;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i > 0)
+            elements.push_back(',');
+        elements.append(std::to_string(static_cast<int>(i * 2654435761u % 200000) - 100000));
+    }
+    best("parse_int_array", n, elements.length(), [&]
+    {
+        ccl_data node;
+        const auto start = bench_clock::now();
+        node.set_value(elements, ccl_type_int_array);
+        sink = sink + node.get_int_array().size();
+        return seconds_since(start);
+    });
+
+    /* Build the cache first, so only loading it is measured */
+    {
+        ccl_config cfg(path, "", ccl_load_cache);
+    }
+    best("load_cache", n, bytes, [&]
+    {
+        const auto start = bench_clock::now();
+        ccl_config cfg(path, "", ccl_load_cache);
+        return seconds_since(start);
+    });
+
+    ccl_config cfg(path, "");
+
+    /* Write a copy, so the source stays intact */
+    std::error_code ec;
+    std::filesystem::copy_file(path, out_path,
+        std::filesystem::copy_options::overwrite_existing, ec);
+
+    best("write", n, bytes, [&]
+    {
+        ccl_config out(out_path, "");
+        const auto start = bench_clock::now();
+        out.write();
+        return seconds_since(start);
+    });
+
+    best("get_hit", n, 0, [&]
+    {
+        const auto start = bench_clock::now();
+        sink = sink + read_all(cfg, types, keys);
+        return seconds_since(start);
+    });
+
+    std::vector<ccl_handle<int>> handles;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (types[i] == ccl_type_int)
+            handles.push_back(cfg.handle<int>(keys[i]));
+    }
+    best("handle_get_int", handles.size(), 0, [&]
+    {
+        const auto start = bench_clock::now();
+        size_t sum = 0;
+        for (const auto& h : handles)
+            sum += h.get();
+        sink = sink + sum;
+        return seconds_since(start);
+    });
+
+    std::vector<int> values(handles.size());
+    std::vector<ccl_binding> bindings;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (types[i] == ccl_type_int)
+            bindings.emplace_back(keys[i], &values[bindings.size()]);
+    }
+    best("batch_get_int", bindings.size(), 0, [&]
+    {
+        const auto start = bench_clock::now();
+        cfg.get_batch(bindings.data(), bindings.size());
+        sink = sink + values.back();
+        return seconds_since(start);
+    });
+
+    cfg.publish();
+    best("snapshot_get_hit", n, 0, [&]
+    {
+        const auto start = bench_clock::now();
+        const auto snapshot = cfg.snapshot();
+        sink = sink + read_all(*snapshot.get(), types, keys);
+        return seconds_since(start);
+    });
+
+    /* Every key comes from the lowest of three layers */
+    ccl_config site, user;
+    ccl_layered_config layered;
+    layered.add_layer(&cfg);
+    layered.add_layer(&site);
+    layered.add_layer(&user);
+    best("layered_get_hit", n, 0, [&]
+    {
+        const auto start = bench_clock::now();
+        sink = sink + read_all(layered, types, keys);
+        return seconds_since(start);
+    });
+
+    /* Keys are spread over 64 sections, see key_name() */
+    std::vector<std::string> sections;
+    for (size_t i = 0; i < 64; i++)
+        sections.push_back("section" + std::to_string(i) + ".");
+    best("prefix_count", sections.size(), 0, [&]
+    {
+        const auto start = bench_clock::now();
+        size_t count = 0;
+        for (const auto& s : sections)
+            count += cfg.count_prefix(s);
+        sink = sink + count;
+        return seconds_since(start);
+    });
+
+    best("get_miss", n, 0, [&]
+    {
+        const auto start = bench_clock::now();
+        for (const auto& k : missing)
+            sink = sink + cfg.get_int(k, true);
+        return seconds_since(start);
+    });
+
+    best("node_exists_miss", n, 0, [&]
+    {
+        const auto start = bench_clock::now();
+        for (const auto& k : missing)
+            sink = sink + cfg.node_exists(k);
+        return seconds_since(start);
+    });
+
+    best("set_hit", n, 0, [&]
+    {
+        const auto start = bench_clock::now();
+        write_all(cfg, types, keys);
+        return seconds_since(start);
+    });
+
+    best("set_journal", n, 0, [&]
+    {
+        ccl_config journaled(out_path, "", ccl_load_journal);
+        journaled.set_journal_limit(0);
+        const auto start = bench_clock::now();
+        write_all(journaled, types, keys);
+        const auto t = seconds_since(start);
+        journaled.compact();
+        return t;
+    });
+
+    best("set_miss", n, 0, [&]
+    {
+        const auto start = bench_clock::now();
+        for (const auto& k : missing)
+            cfg.set_int(k, 1);
+        return seconds_since(start);
+    });
+
+    best("add_node", n, 0, [&]
+    {
+        ccl_config empty;
+        const auto start = bench_clock::now();
+        add_all(empty, types, keys);
+        return seconds_since(start);
+    });
+
+    best("add_node_intern", n, 0, [&]
+    {
+        ccl_config empty;
+        empty.set_flags(ccl_load_intern);
+        const auto start = bench_clock::now();
+        add_all(empty, types, keys);
+        return seconds_since(start);
+    });
+
+    std::remove(path.c_str());
+    std::remove((path + ".cclb").c_str());
+    std::remove(out_path.c_str());
+}
+
+static void print(const bench_options& opt, const std::vector<bench_result>& results)
+{
+    auto f = stdout;
+    if (!opt.out.empty())
+    {
+        f = fopen(opt.out.c_str(), "w");
+        if (!f)
+        {
+            fprintf(stderr, "Couldn't open %s\n", opt.out.c_str());
+            return;
+        }
+    }
+
+    if (opt.json)
+        fprintf(f, "[\n");
+    else
+        fprintf(f, "benchmark,keys,ops,seconds,ns_per_op,ops_per_sec,mb_per_sec\n");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const auto& r = results[i];
+        const auto ns = r.seconds * 1e9 / r.ops;
+        const auto ops = r.ops / r.seconds;
+        const auto mbs = r.bytes / r.seconds / (1024 * 1024);
+
+        if (opt.json)
+            fprintf(f, "  { \"benchmark\": \"%s\", \"keys\": %zu, \"ops\": %zu, "
+                "\"seconds\": %.9f, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, "
+                "\"mb_per_sec\": %.2f }%s\n", r.name.c_str(), r.keys, r.ops,
+                r.seconds, ns, ops, mbs, i + 1 < results.size() ? "," : "");
+        else
+            fprintf(f, "%s,%zu,%zu,%.9f,%.2f,%.0f,%.2f\n", r.name.c_str(), r.keys,
+                r.ops, r.seconds, ns, ops, mbs);
+    }
+
+    if (opt.json)
+        fprintf(f, "]\n");
+    if (f != stdout)
+        fclose(f);
+}
+
+int main(int argc, char** argv)
+{
+    bench_options opt;
+    opt.dir = std::filesystem::temp_directory_path().string();
+
+    for (auto i = 1; i < argc; i++)
+    {
+        const auto has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--sizes") && has_value)
+        {
+            opt.sizes.clear();
+            std::string list = argv[++i];
+            size_t start = 0;
+            while (start < list.length())
+            {
+                auto end = list.find(',', start);
+                if (end == std::string::npos)
+                    end = list.length();
+                opt.sizes.push_back(std::stoul(list.substr(start, end - start)));
+                start = end + 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--reps") && has_value)
+        {
+            opt.reps = std::max(1, atoi(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "--seed") && has_value)
+        {
+            opt.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "--format") && has_value)
+        {
+            opt.json = !strcmp(argv[++i], "json");
+        }
+        else if (!strcmp(argv[i], "--out") && has_value)
+        {
+            opt.out = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--dir") && has_value)
+        {
+            opt.dir = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--sizes 1000,10000,...] [--reps n] [--seed n]"
+                " [--format csv|json] [--out file] [--dir path]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<bench_result> results;
+    for (const auto n : opt.sizes)
+        run(opt, n, results);
+
+    print(opt, results);
+    return 0;
+}
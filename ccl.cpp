@@ -6,11 +6,46 @@
 #include <fstream>
 #include <map>
 #include <vector>
-#include <sstream>
+#include <cstring>
+#include <charconv>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <unordered_set>
+#include <unordered_map>
 
 #ifdef _WIN32
 #include <io.h>
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* Text is scanned with SSE2 or AVX2 where available,
+   define CCL_NO_SIMD to only use the scalar scanner */
+#if !defined(CCL_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#define CCL_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define CCL_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define CCL_TARGET_AVX2
+#else
+#define CCL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
 #endif
 
 /**
@@ -28,868 +63,4581 @@ std::string format(const char* format, Args ... args)
     return std::string(buf.get(), buf.get() + size - 1);
 }
 
-ccl_data::ccl_data(const std::string& id, const std::string& comment, const std::string& val,
-    const data_type type)
+/* Adds n to a counter, which only one thread changes, so it
+   doesn't need the locked instruction of fetch_add() */
+static inline void stat_add(std::atomic<uint64_t>& counter, const uint64_t n)
 {
-    m_comment_ = comment;
-    m_id_ = id;
-    m_type_ = type;
-    m_value_ = val;
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
 }
 
-ccl_data::ccl_data(const std::string& id, const std::string& comment, const int value)
-{
-    m_comment_ = comment;
-    m_id_ = id;
-    set_int(value);
-}
+/* Adds n to a counter of ccl_config::m_stats_ */
+#ifdef CCL_NO_STATS
+#define CCL_COUNT(counter, n) ((void)0)
+#define CCL_TIME(counter) ((void)0)
+#else
+#define CCL_COUNT(counter, n) stat_add(m_stats_.counter, (n))
+#define CCL_TIME(counter) const stats_timer timer_(m_stats_.counter)
 
-ccl_data::ccl_data(const std::string& id, const std::string& comment, const float value)
+/* Adds the nanoseconds until it goes out of scope to a counter */
+class stats_timer
 {
-    m_comment_ = comment;
-    m_id_ = id;
-    set_float(value);
-}
+public:
+    explicit stats_timer(std::atomic<uint64_t>& counter)
+        : m_counter_(counter), m_start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~stats_timer()
+    {
+        const auto time = std::chrono::steady_clock::now() - m_start_;
+        stat_add(m_counter_, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(time).count()));
+    }
+private:
+    std::atomic<uint64_t>& m_counter_;
+    std::chrono::steady_clock::time_point m_start_;
+};
+#endif
 
-ccl_data::ccl_data(const std::string& id, const std::string& comment, const bool value)
+static ccl_error make_error(const error_code code, const error_level lvl,
+    const std::string_view key, const int line, const int detail)
 {
-    m_comment_ = comment;
-    m_id_ = id;
-    set_bool(value);
+    ccl_error error;
+    error.code = code;
+    error.level = lvl;
+    error.line = line;
+    error.detail = detail;
+    error.key_truncated = key.length() > sizeof(error.key);
+    error.key_length = static_cast<uint8_t>(std::min(key.length(), sizeof(error.key)));
+    if (error.key_length > 0)
+        memcpy(error.key, key.data(), error.key_length);
+    return error;
 }
 
-ccl_data::ccl_data(const std::string& id, const std::string& comment, const std::string& value)
+ccl_arena::~ccl_arena()
 {
-    m_comment_ = comment;
-    m_id_ = id;
-    set_string(value);
+    release();
 }
 
-ccl_data::ccl_data(const std::string& id, const std::string& comment, const int x, const int y)
+void* ccl_arena::allocate(const size_t size, const size_t align)
 {
-    m_comment_ = comment;
-    m_id_ = id;
-    set_point(x, y);
+    auto pos = reinterpret_cast<char*>(
+        (reinterpret_cast<uintptr_t>(m_pos_) + align - 1) & ~(align - 1));
+
+    if (!m_block_ || pos + size > m_end_)
+    {
+        add_block(size + align);
+        pos = reinterpret_cast<char*>(
+            (reinterpret_cast<uintptr_t>(m_pos_) + align - 1) & ~(align - 1));
+    }
+
+    m_used_ += pos + size - m_pos_;
+    m_pos_ = pos + size;
+    return pos;
 }
 
-ccl_data::ccl_data(const std::string& id, const std::string& comment,
-    const int x, const int y, const int w, const int h)
+char* ccl_arena::allocate_string(const size_t length)
 {
-    m_comment_ = comment;
-    m_id_ = id;
-    set_rect(x, y, w, h);
+    return static_cast<char*>(allocate(length, 1));
 }
 
-ccl_data::~ccl_data()
+size_t ccl_arena::size_class(const size_t size)
 {
-    free();
+    if (size <= 128)
+        return size == 0 ? 0 : (size - 1) / 8;
+
+    size_t c = 16;
+    for (size_t bytes = 256; bytes < size; bytes <<= 1)
+        c++;
+    return c;
 }
 
-ccl_data* ccl_data::get_next() const
+size_t ccl_arena::reusable_size(const size_t size)
 {
-    return m_next_;
+    const auto c = size_class(size);
+    return c < 16 ? (c + 1) * 8 : size_t(256) << (c - 16);
 }
 
-std::string ccl_data::get_id() const
+void* ccl_arena::allocate_reusable(const size_t size)
 {
-    return m_id_;
+    const auto bytes = reusable_size(size);
+    auto& head = m_free_[size_class(size)];
+    if (!head)
+        return allocate(bytes, 8);
+
+    const auto p = head;
+    memcpy(&head, p, sizeof(void*));
+    m_used_ += bytes;
+    return p;
 }
 
-std::string ccl_data::get_value() const
+void ccl_arena::deallocate(void* p, const size_t size)
 {
-    return m_value_;
+    if (!p || size == 0)
+        return;
+
+    auto& head = m_free_[size_class(size)];
+    memcpy(p, &head, sizeof(void*));
+    head = p;
+    m_used_ -= reusable_size(size);
 }
 
-std::string ccl_data::get_comment() const
+std::string_view ccl_arena::copy(const std::string_view str)
 {
-    return m_comment_;
+    if (str.empty())
+        return {};
+    const auto data = allocate_string(str.length());
+    memcpy(data, str.data(), str.length());
+    return { data, str.length() };
 }
 
-data_type ccl_data::get_type() const
+std::string_view ccl_arena::intern(const std::string_view str)
 {
-    return m_type_;
+    if (!m_interning_ || str.empty())
+        return copy(str);
+
+    /* Keep the table at most 3/4 full */
+    if ((m_interned_count_ + 1) * 4 > m_interned_.size() * 3)
+        grow_interned();
+
+    const auto h = ccl_index::hash(str.data(), str.length());
+    const auto mask = m_interned_.size() - 1;
+    for (auto i = h & mask;; i = (i + 1) & mask)
+    {
+        auto& slot = m_interned_[i];
+        if (!slot.data)
+        {
+            const auto stored = copy(str);
+            slot = { h, stored.data(), stored.length() };
+            m_interned_count_++;
+            m_interned_bytes_ += stored.length();
+            return stored;
+        }
+        if (slot.hash == h && std::string_view(slot.data, slot.length) == str)
+            return { slot.data, slot.length };
+    }
 }
 
-void ccl_data::set_next(ccl_data* next)
+bool ccl_arena::is_interned(const std::string_view str) const
 {
-    m_next_ = next;
+    if (m_interned_.empty() || str.empty())
+        return false;
+
+    const auto h = ccl_index::hash(str.data(), str.length());
+    const auto mask = m_interned_.size() - 1;
+    for (auto i = h & mask; m_interned_[i].data; i = (i + 1) & mask)
+    {
+        if (m_interned_[i].hash == h && m_interned_[i].length == str.length())
+            return m_interned_[i].data == str.data();
+    }
+    return false;
 }
 
-void ccl_data::set_int(const int val)
+void ccl_arena::grow_interned()
 {
-    m_type_ = ccl_type_int;
-    m_value_.clear();
-    m_value_ = std::to_string(val);
+    std::vector<interned> old(std::max<size_t>(m_interned_.size() * 2, 64));
+    old.swap(m_interned_);
+
+    const auto mask = m_interned_.size() - 1;
+    for (const auto& slot : old)
+    {
+        if (!slot.data)
+            continue;
+        auto i = slot.hash & mask;
+        while (m_interned_[i].data)
+            i = (i + 1) & mask;
+        m_interned_[i] = slot;
+    }
 }
 
-void ccl_data::set_float(const float val)
+void ccl_arena::clear_interned()
 {
-    m_type_ = ccl_type_float;
-    m_value_.clear();
-    m_value_ = std::to_string(val);
+    /* Keeps the table, the strings are gone with the memory */
+    std::fill(m_interned_.begin(), m_interned_.end(), interned{});
+    m_interned_count_ = 0;
+    m_interned_bytes_ = 0;
 }
 
-void ccl_data::set_bool(const bool val)
+void ccl_arena::adopt(ccl_arena& other)
 {
-    m_type_ = ccl_type_bool;
-    m_value_.clear();
-    m_value_ = std::to_string(val);
+    if (!other.m_block_)
+        return;
+
+    if (!m_block_)
+    {
+        m_block_ = other.m_block_;
+        m_pos_ = other.m_pos_;
+        m_end_ = other.m_end_;
+    }
+    else
+    {
+        /* Keep allocating from the current block */
+        auto oldest = other.m_block_;
+        while (oldest->prev)
+            oldest = oldest->prev;
+        oldest->prev = m_block_->prev;
+        m_block_->prev = other.m_block_;
+    }
+
+    m_used_ += other.m_used_;
+    m_capacity_ += other.m_capacity_;
+    stat_add(m_blocks_allocated_, other.blocks_allocated());
+    other.m_block_ = nullptr;
+    other.m_pos_ = nullptr;
+    other.m_end_ = nullptr;
+    other.m_used_ = 0;
+    other.m_capacity_ = 0;
+    /* Strings interned by other stay valid, but aren't shared.
+       Its free blocks are only reclaimed with this arena */
+    other.clear_interned();
+    std::fill(std::begin(other.m_free_), std::end(other.m_free_), nullptr);
 }
 
-void ccl_data::set_string(const std::string& val)
+void ccl_arena::reset()
 {
-    set_value(val, ccl_type_string);
+    /* Only keep the block we're currently allocating from */
+    if (m_block_)
+    {
+        auto b = m_block_->prev;
+        while (b)
+        {
+            const auto prev = b->prev;
+            m_capacity_ -= b->size;
+            ::operator delete(b);
+            b = prev;
+        }
+        m_block_->prev = nullptr;
+        m_pos_ = reinterpret_cast<char*>(m_block_ + 1);
+    }
+    m_used_ = 0;
+    std::fill(std::begin(m_free_), std::end(m_free_), nullptr);
+    clear_interned();
 }
 
-void ccl_data::set_value(const std::string& val, const data_type t)
+void ccl_arena::release()
 {
-    m_type_ = t;
-    m_value_.clear();
-    m_value_ = val;
+    while (m_block_)
+    {
+        const auto prev = m_block_->prev;
+        ::operator delete(m_block_);
+        m_block_ = prev;
+    }
+    m_pos_ = nullptr;
+    m_end_ = nullptr;
+    m_used_ = 0;
+    m_capacity_ = 0;
+    std::fill(std::begin(m_free_), std::end(m_free_), nullptr);
+    m_interned_ = std::vector<interned>();
+    m_interned_count_ = 0;
+    m_interned_bytes_ = 0;
 }
 
-void ccl_data::set_comment(const std::string& comment)
+void ccl_arena::add_block(const size_t min_size)
 {
-    m_comment_ = comment;
+    /* Blocks double in size up to 1MB, bigger allocations get their own */
+    auto size = m_block_ ? std::min<size_t>(m_block_->size * 2, 1 << 20) : 4096;
+    size = std::max(size, min_size);
+
+    const auto b = static_cast<block*>(::operator new(sizeof(block) + size));
+    b->prev = m_block_;
+    b->size = size;
+    m_block_ = b;
+    m_pos_ = reinterpret_cast<char*>(b + 1);
+    m_end_ = m_pos_ + size;
+    m_capacity_ += size;
+    stat_add(m_blocks_allocated_, 1);
 }
 
-void ccl_data::set_point(const int x, const int y)
+ccl_str::ccl_str(const ccl_str& other)
 {
-    m_type_ = ccl_type_point;
-    m_value_ = std::to_string(x) + "," + std::to_string(y);
+    *this = other;
 }
 
-void ccl_data::set_rect(const int x, const int y, const int w, const int h)
+ccl_str::~ccl_str()
 {
-    m_type_ = ccl_type_rect;
-    m_value_ = std::to_string(x) + "," + std::to_string(y) + ","
-        + std::to_string(w) + "," + std::to_string(h);
+    clear();
 }
 
-void ccl_data::free()
+ccl_str& ccl_str::operator=(const ccl_str& other)
 {
-    m_id_.clear();
-    m_value_.clear();
-    m_comment_.clear();
-    m_next_ = nullptr;
+    if (this == &other)
+        return *this;
+    if (other.m_storage_ == storage_heap)
+        assign(other.view());
+    else
+        reference(other.view());
+    return *this;
 }
 
-ccl_config::ccl_config()
+void ccl_str::assign(const std::string_view str, ccl_arena* arena)
 {
-    m_empty_ = true;
-    m_first_node_ = nullptr;
-    m_header_ = "";
-#ifdef _MSC_VER
-    m_path_ = L"";
-#else
-	m_path_ = "";
-#endif
+    if (str.empty())
+    {
+        clear(arena);
+        return;
+    }
+
+    /* str can be part of this string, which reset() could free */
+    if (!referenced() && str.data() >= m_data_ && str.data() < m_data_ + m_length_)
+    {
+        const std::string copy(str);
+        memcpy(reset(copy.length(), arena), copy.data(), copy.length());
+        return;
+    }
+    memcpy(reset(str.length(), arena), str.data(), str.length());
 }
 
-ccl_config::ccl_config(const std::string& path, std::string header)
+char* ccl_str::reset(const size_t length, ccl_arena* arena)
 {
-    m_empty_ = true;
-    m_first_node_ = nullptr;
-    m_header_ = std::move(header);
-#ifdef _MSC_VER
-    m_path_ = to_utf_16(path);
-#else
-	m_path_ = path;
-#endif
+    if (arena && m_storage_ == storage_arena && length > 0
+        && ccl_arena::reusable_size(length) == ccl_arena::reusable_size(m_length_))
+    {
+        /* Reuse the old copy */
+        m_length_ = length;
+        return const_cast<char*>(m_data_);
+    }
 
-    load();
+    clear(arena);
+    if (length == 0)
+        return nullptr;
+
+    char* data;
+    if (arena)
+    {
+        data = static_cast<char*>(arena->allocate_reusable(length));
+        m_storage_ = storage_arena;
+    }
+    else
+    {
+        /* Aligned for any type, which arrays rely on */
+        data = new char[length];
+        m_storage_ = storage_heap;
+    }
+    m_data_ = data;
+    m_length_ = length;
+    return data;
 }
 
-#ifdef _MSC_VER
-ccl_config::ccl_config(std::wstring path, std::string header)
+void ccl_str::reference(const std::string_view str)
 {
-    m_empty_ = true;
-    m_first_node_ = nullptr;
-    m_header_ = std::move(header);
-    m_path_ = std::move(path);
-    load();
+    clear();
+    m_data_ = str.data();
+    m_length_ = str.length();
 }
-#endif
 
-ccl_config::~ccl_config()
+void ccl_str::clear(ccl_arena* arena)
 {
-    if (!m_empty_)
-        free_nodes();
-    m_empty_ = true;
-    m_header_ = "";
-    m_path_.clear();
+    if (m_storage_ == storage_heap)
+        delete[] m_data_;
+    else if (m_storage_ == storage_arena && arena)
+        arena->deallocate(const_cast<char*>(m_data_), m_length_);
+    m_data_ = "";
+    m_length_ = 0;
+    m_storage_ = storage_reference;
 }
 
-void ccl_config::free_nodes()
+/* Parses an integer like std::stoi without allocating or throwing
+   Leading whitespace is skipped and pos is moved past the number */
+static bool parse_int(const char*& pos, const char* end, int& out)
 {
-    auto node = m_first_node_;
-    ccl_data* next = nullptr;
-
-    while (node)
-    {
-        next = node->get_next();
-        delete node;
-        node = next;
-    }
-    m_first_node_ = nullptr;
-    m_empty_ = true;
-    node = nullptr;
+    while (pos < end && (*pos == ' ' || *pos == '\t'))
+        pos++;
+    if (pos < end && *pos == '+')
+        pos++;
+
+    const auto result = std::from_chars(pos, end, out);
+    if (result.ec != std::errc())
+        return false;
+    pos = result.ptr;
+    return true;
 }
 
-inline bool read_line(std::ifstream& stream, std::string& line, int& line_index)
+static bool parse_int64(const char*& pos, const char* end, int64_t& out)
 {
-    line_index++;
-    return std::getline(stream, line).good();
+    while (pos < end && (*pos == ' ' || *pos == '\t'))
+        pos++;
+    if (pos < end && *pos == '+')
+        pos++;
+
+    const auto result = std::from_chars(pos, end, out);
+    if (result.ec != std::errc())
+        return false;
+    pos = result.ptr;
+    return true;
 }
 
-void ccl_config::load()
+/* Parses a float or double, independent of the locale if the
+   standard library has floating point from_chars */
+template <class T>
+static bool parse_real(const char*& pos, const char* end, T& out)
 {
-    if (!can_load())
-    {
-        return;
-    }
-
-    std::ifstream f(m_path_.c_str());
-
-    if (f.good())
-    {
-        std::string line;
-        std::getline(f, line);
-        auto line_index = 1;
-
-        if (!line.empty())
-        {
-            if (line.at(0) == '#')
-            {
-                m_header_ = line.erase(0, 2);
-		read_line(f, line, line_index);
-            }
-#ifdef _DEBUG
-                /* Another redundant error */
-            else
-            {
-                add_error(
-                    "Line one in config should be a header comment! \
-First value skipped!",
-                    ccl_error_normal);
-            }
+    while (pos < end && (*pos == ' ' || *pos == '\t'))
+        pos++;
+#ifdef __cpp_lib_to_chars
+    if (pos < end && *pos == '+')
+        pos++;
+
+    const auto result = std::from_chars(pos, end, out);
+    if (result.ec != std::errc())
+        return false;
+    pos = result.ptr;
+#else
+    /* strtod needs a terminated string */
+    char buf[64];
+    const auto length = std::min(static_cast<size_t>(end - pos), sizeof(buf) - 1);
+    memcpy(buf, pos, length);
+    buf[length] = '\0';
+
+    char* parsed = nullptr;
+    out = static_cast<T>(strtod(buf, &parsed));
+    if (parsed == buf)
+        return false;
+    pos += parsed - buf;
 #endif
-        }
+    return true;
+}
 
-        do
-        {
-            /* Skip all comments and save last one */
-            std::string comment;
-            if (line.empty())
-            {
-#if _DEBUG /* This error is redundant */
-                add_error(format(
-                        "Line %i was empty! Skipping.", line_index),
-                    ccl_error_normal);
+/* Appends the shortest text that parses back to the same value */
+template <class T>
+static void append_real(std::string& out, const T value)
+{
+    char buf[64];
+#ifdef __cpp_lib_to_chars
+    const auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr - buf);
+#else
+    const auto length = snprintf(buf, sizeof(buf), "%.*g",
+        std::numeric_limits<T>::max_digits10, static_cast<double>(value));
+    out.append(buf, std::min<size_t>(length, sizeof(buf) - 1));
 #endif
-                continue;
-            }
-
-            while (!line.empty() && line.at(0) == '#')
-            {
-                comment = line;
-		read_line(f, line, line_index);
-            }
-
-	    if (line.empty())
-		    continue;
-
-            /* Read in the value type */
-            const auto type = util_parse_type(line.at(0));
-
-            if (type == ccl_type_invalid)
-            {
-                add_error(format(
-                        "Invalid type '%c' at line %i", line.at(0),
-                        line_index),
-                    ccl_error_normal);
-                continue;
-            }
-
-            line = line.erase(0, 2);
-
-            if (line.find("\\n") != std::string::npos)
-            {
-                size_t start_pos = 0;
-                while ((start_pos = line.find("\\n", start_pos)) !=
-                    std::string::npos)
-                {
-                    line.replace(start_pos, 2, "\n");
-                    start_pos += 1;
-                }
-            }
+}
 
-#ifdef LINUX
-            if (line.find('\r') != std::string::npos)
-            {
-                line.replace(line.find('\r'), 1, "");
-            }
+static inline int lowest_bit(const uint64_t v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return static_cast<int>(i);
+#elif defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    auto i = 0;
+    while (!(v & (1ull << i)))
+        i++;
+    return i;
 #endif
+}
 
-            std::string segment;
-            std::vector<std::string> segments;
-            std::stringstream stream(line);
-
-            while (std::getline(stream, segment, '='))
-            {
-                segments.push_back(segment);
-            }
-
-            if (segments.empty())
-            {
-                add_error(format(
-                        "Invalid value at line %i. No '=' found",
-                        line_index),
-                    ccl_error_normal);
-                continue;
-            }
+#if !(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+/* Number of decimal digits at the start of eight bytes of text,
+   read as a little endian word */
+static inline int digit_count(const uint64_t word)
+{
+    /* Bytes other than '0' to '9' become non zero. Adding 6 only
+       carries out of non digits, which can't affect earlier bytes */
+    const auto t = ((word & 0xf0f0f0f0f0f0f0f0ull) ^ 0x3030303030303030ull)
+        | (((word + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) ^ 0x3030303030303030ull);
+    const auto non_digits = (((t & 0x7f7f7f7f7f7f7f7full) + 0x7f7f7f7f7f7f7f7full) | t)
+        & 0x8080808080808080ull;
+    return non_digits ? lowest_bit(non_digits) / 8 : 8;
+}
 
-            const auto new_node = new ccl_data(
-                segments[0], comment.erase(0, 2), segments[1], type);
-            add_node(new_node);
-        } while (read_line(f, line, line_index));
+/* Value of the first n (1 to 7) digits of a little endian word */
+static inline uint32_t digits_value(uint64_t word, const int n)
+{
+    /* Move the digits to the top and fill the bottom with '0' */
+    word = (word << (64 - 8 * n)) | (0x3030303030303030ull >> (8 * n));
+    word -= 0x3030303030303030ull;
+    /* Combine pairs of digits, then pairs of those */
+    word = word * 10 + (word >> 8);
+    word = (((word & 0x000000ff000000ffull) * (100 + (1000000ull << 32)))
+        + (((word >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32)))) >> 32;
+    return static_cast<uint32_t>(word);
+}
+#endif
 
-        if (m_first_node_)
-        {
-            m_empty_ = false;
-        }
-    }
+/* parse_int() for array elements, numbers with up to seven
+   digits are converted without a loop on little endian CPUs */
+static bool parse_int_swar(const char*& pos, const char* end, int& out)
+{
+#if !(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    auto p = pos;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    const auto negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+
+    /* Missing bytes at the end are zero, which isn't a digit */
+    uint64_t word = 0;
+    if (end - p >= 8)
+        memcpy(&word, p, 8);
     else
+        memcpy(&word, p, static_cast<size_t>(end - p));
+    const auto n = digit_count(word);
+    if (n > 0 && n < 8)
     {
-        add_error(format(
-                "File %s does not exist or cannot be accessed", m_path_),
-            ccl_error_normal);
+        const auto value = static_cast<int>(digits_value(word, n));
+        out = negative ? -value : value;
+        pos = p + n;
+        return true;
     }
+#endif
+    /* Longer numbers could overflow */
+    return parse_int(pos, end, out);
 }
 
-void ccl_config::write(const bool comments)
+/* Parses a comma separated list into count elements */
+template <class T, class F>
+static bool parse_list(const char* pos, const char* end, T* out, const size_t count, F&& parse)
 {
-    if (m_path_.empty())
+    for (size_t i = 0; i < count; i++)
     {
-        return;
+        if (i > 0)
+        {
+            while (pos < end && (*pos == ' ' || *pos == '\t'))
+                pos++;
+            if (pos >= end || *pos != ',')
+                return false;
+            pos++;
+        }
+        if (!parse(pos, end, out[i]))
+            return false;
     }
+    return true;
+}
 
-#ifdef _MSC_VER
-    DeleteFileW(m_path_.c_str());
-#else
-	std::remove(m_path_.c_str());
-#endif
-    std::ofstream fs(m_path_.c_str());
-
-    if (fs)
+/* Parses a comma separated list of count integers */
+static bool parse_ints(const char* pos, const char* end, int* out, const int count)
+{
+    for (auto i = 0; i < count; i++)
     {
-        auto next = m_first_node_;
-        if (comments)
-            fs << "# " << m_header_.c_str() << std::endl;
-
-        while (next)
+        if (i > 0)
         {
-            if (comments && !next->get_comment().empty())
-            {
-                fs << "# " << next->get_comment().c_str() << std::endl;
-            }
-
-            fs << next->get_type() << "_"
-                << next->get_id().c_str() << "="
-                << next->get_value().c_str() << std::endl;
-            next = next->get_next();
+            if (pos >= end || *pos != ',')
+                return false;
+            pos++;
         }
-
-        fs.close();
-    }
-    else
-    {
-        add_error(format("Couldn't write to %s", m_path_.c_str()),
-            ccl_error_fatal);
+        if (!parse_int(pos, end, out[i]))
+            return false;
     }
+    return true;
 }
 
-bool ccl_config::is_empty() const
+ccl_data::ccl_data(const std::string_view id, const std::string_view comment, const std::string_view val,
+    const data_type type)
 {
-    return m_empty_;
+    m_comment_.assign(comment);
+    m_id_.assign(id);
+    /* Copies strings, val doesn't have to outlive the node */
+    set_value(val, type);
 }
 
-bool ccl_config::can_write() const
+ccl_data::ccl_data(const std::string_view id, const std::string_view comment, const int value)
 {
-    auto result = false;
-#ifdef _WIN32
-    if (_waccess(m_path_.c_str(), F_OK) == -1)
-    {
-        /* Create file first */
-		std::ofstream stream;
-		stream.open(m_path_.c_str());
-		stream << "";
-		stream.close();
-    }
+    m_comment_.assign(comment);
+    m_id_.assign(id);
+    set_int(value);
+}
 
-    result = _waccess(m_path_.c_str(), W_OK) == 0;
-#else
-    if (access(m_path_.c_str(), F_OK) == -1)
-    {
-		/* Create file first */
-		std::ofstream stream;
+ccl_data::ccl_data(const std::string_view id, const std::string_view comment, const float value)
+{
+    m_comment_.assign(comment);
+    m_id_.assign(id);
+    set_float(value);
+}
+
+ccl_data::ccl_data(const std::string_view id, const std::string_view comment, const bool value)
+{
+    m_comment_.assign(comment);
+    m_id_.assign(id);
+    set_bool(value);
+}
+
+ccl_data::ccl_data(const std::string_view id, const std::string_view comment, const std::string_view value)
+{
+    m_comment_.assign(comment);
+    m_id_.assign(id);
+    set_string(value);
+}
+
+ccl_data::ccl_data(const std::string_view id, const std::string_view comment, const int x, const int y)
+{
+    m_comment_.assign(comment);
+    m_id_.assign(id);
+    set_point(x, y);
+}
+
+ccl_data::ccl_data(const std::string_view id, const std::string_view comment,
+    const int x, const int y, const int w, const int h)
+{
+    m_comment_.assign(comment);
+    m_id_.assign(id);
+    set_rect(x, y, w, h);
+}
+
+ccl_data::~ccl_data()
+{
+    free();
+}
+
+ccl_data* ccl_data::get_next() const
+{
+    return m_next_;
+}
+
+std::string ccl_data::get_id() const
+{
+    return std::string(m_id_.view());
+}
+
+std::string ccl_data::get_value() const
+{
+    std::string value;
+    append_value(value, false);
+    return value;
+}
+
+std::string ccl_data::get_comment() const
+{
+    return std::string(m_comment_.view());
+}
+
+data_type ccl_data::get_type() const
+{
+    return m_type_;
+}
+
+std::string_view ccl_data::get_id_view() const
+{
+    return m_id_.view();
+}
+
+std::string_view ccl_data::get_comment_view() const
+{
+    return m_comment_.view();
+}
+
+std::string_view ccl_data::get_string() const
+{
+    resolve();
+    return m_type_ == ccl_type_string ? m_string_.view() : std::string_view();
+}
+
+int ccl_data::get_int() const
+{
+    resolve();
+    return m_type_ == ccl_type_int ? m_value_.i : 0;
+}
+
+float ccl_data::get_float() const
+{
+    resolve();
+    return m_type_ == ccl_type_float ? m_value_.f : 0.f;
+}
+
+int64_t ccl_data::get_int64() const
+{
+    resolve();
+    return m_type_ == ccl_type_int64 ? m_value_.l : 0;
+}
+
+double ccl_data::get_double() const
+{
+    resolve();
+    return m_type_ == ccl_type_double ? m_value_.d : 0.0;
+}
+
+bool ccl_data::get_bool() const
+{
+    resolve();
+    return m_type_ == ccl_type_bool && m_value_.b;
+}
+
+ccl_point ccl_data::get_point() const
+{
+    resolve();
+    return m_type_ == ccl_type_point ? m_value_.point : ccl_point();
+}
+
+ccl_rect ccl_data::get_rect() const
+{
+    resolve();
+    return m_type_ == ccl_type_rect ? m_value_.rect : ccl_rect();
+}
+
+ccl_span<const int> ccl_data::get_int_array() const
+{
+    resolve();
+    return m_type_ == ccl_type_int_array ? array_of<int>() : ccl_span<const int>();
+}
+
+ccl_span<const float> ccl_data::get_float_array() const
+{
+    resolve();
+    return m_type_ == ccl_type_float_array ? array_of<float>() : ccl_span<const float>();
+}
+
+void ccl_data::set_next(ccl_data* next)
+{
+    m_next_ = next;
+}
+
+void ccl_data::set_int(const int val)
+{
+    m_type_ = ccl_type_int;
+    m_raw_ = raw_none;
+    m_string_.clear(m_arena_);
+    m_value_.i = val;
+}
+
+void ccl_data::set_float(const float val)
+{
+    m_type_ = ccl_type_float;
+    m_raw_ = raw_none;
+    m_string_.clear(m_arena_);
+    m_value_.f = val;
+}
+
+void ccl_data::set_int64(const int64_t val)
+{
+    m_type_ = ccl_type_int64;
+    m_raw_ = raw_none;
+    m_string_.clear(m_arena_);
+    m_value_.l = val;
+}
+
+void ccl_data::set_double(const double val)
+{
+    m_type_ = ccl_type_double;
+    m_raw_ = raw_none;
+    m_string_.clear(m_arena_);
+    m_value_.d = val;
+}
+
+void ccl_data::set_bool(const bool val)
+{
+    m_type_ = ccl_type_bool;
+    m_raw_ = raw_none;
+    m_string_.clear(m_arena_);
+    m_value_.b = val;
+}
+
+void ccl_data::set_string(const std::string_view val)
+{
+    m_type_ = ccl_type_string;
+    m_raw_ = raw_none;
+    share(m_string_, val);
+}
+
+bool ccl_data::set_value(const std::string_view val, const data_type t)
+{
+    /* Parsed strings only reference val, so they're copied directly */
+    if (t == ccl_type_string)
+    {
+        m_value_ = value();
+        set_string(val);
+        return true;
+    }
+    return parse_value(val, t);
+}
+
+void ccl_data::set_comment(const std::string_view comment)
+{
+    share(m_comment_, comment);
+}
+
+void ccl_data::set_point(const int x, const int y)
+{
+    m_type_ = ccl_type_point;
+    m_raw_ = raw_none;
+    m_string_.clear(m_arena_);
+    m_value_.point.x = x;
+    m_value_.point.y = y;
+}
+
+void ccl_data::set_rect(const int x, const int y, const int w, const int h)
+{
+    m_type_ = ccl_type_rect;
+    m_raw_ = raw_none;
+    m_string_.clear(m_arena_);
+    m_value_.rect.x = x;
+    m_value_.rect.y = y;
+    m_value_.rect.w = w;
+    m_value_.rect.h = h;
+}
+
+void ccl_data::set_int_array(const ccl_span<const int> values)
+{
+    store_array(ccl_type_int_array, values.data(), values.size() * sizeof(int));
+}
+
+void ccl_data::set_float_array(const ccl_span<const float> values)
+{
+    store_array(ccl_type_float_array, values.data(), values.size() * sizeof(float));
+}
+
+/* Stores a value of type T in a node */
+static void set_typed(ccl_data* node, const int val) { node->set_int(val); }
+static void set_typed(ccl_data* node, const float val) { node->set_float(val); }
+static void set_typed(ccl_data* node, const int64_t val) { node->set_int64(val); }
+static void set_typed(ccl_data* node, const double val) { node->set_double(val); }
+static void set_typed(ccl_data* node, const bool val) { node->set_bool(val); }
+static void set_typed(ccl_data* node, const std::string_view val) { node->set_string(val); }
+static void set_typed(ccl_data* node, const ccl_point& val) { node->set_point(val.x, val.y); }
+static void set_typed(ccl_data* node, const ccl_rect& val) { node->set_rect(val.x, val.y, val.w, val.h); }
+static void set_typed(ccl_data* node, const std::vector<int>& val) { node->set_int_array(val); }
+static void set_typed(ccl_data* node, const std::vector<float>& val) { node->set_float_array(val); }
+
+template <class T>
+void ccl_data::set(const T& val)
+{
+    set_typed(this, val);
+}
+
+template <> int ccl_data::get_as<int>() const { return m_value_.i; }
+template <> float ccl_data::get_as<float>() const { return m_value_.f; }
+template <> int64_t ccl_data::get_as<int64_t>() const { return m_value_.l; }
+template <> double ccl_data::get_as<double>() const { return m_value_.d; }
+template <> bool ccl_data::get_as<bool>() const { return m_value_.b; }
+template <> ccl_point ccl_data::get_as<ccl_point>() const { return m_value_.point; }
+template <> ccl_rect ccl_data::get_as<ccl_rect>() const { return m_value_.rect; }
+template <> std::string ccl_data::get_as<std::string>() const
+{
+    return std::string(m_string_.view());
+}
+template <> std::vector<int> ccl_data::get_as<std::vector<int>>() const
+{
+    const auto elements = array_of<int>();
+    return std::vector<int>(elements.begin(), elements.end());
+}
+template <> std::vector<float> ccl_data::get_as<std::vector<float>>() const
+{
+    const auto elements = array_of<float>();
+    return std::vector<float>(elements.begin(), elements.end());
+}
+
+template void ccl_data::set<int>(const int&);
+template void ccl_data::set<float>(const float&);
+template void ccl_data::set<int64_t>(const int64_t&);
+template void ccl_data::set<double>(const double&);
+template void ccl_data::set<bool>(const bool&);
+template void ccl_data::set<std::string>(const std::string&);
+template void ccl_data::set<ccl_point>(const ccl_point&);
+template void ccl_data::set<ccl_rect>(const ccl_rect&);
+template void ccl_data::set<std::vector<int>>(const std::vector<int>&);
+template void ccl_data::set<std::vector<float>>(const std::vector<float>&);
+
+void ccl_data::free()
+{
+    m_id_.clear(m_arena_);
+    m_string_.clear(m_arena_);
+    m_comment_.clear(m_arena_);
+    m_next_ = nullptr;
+    m_prev_ = nullptr;
+}
+
+/* Parses a comma separated list into elements of type T, which
+   are copied into out. They're allocated in the arena if there is one */
+template <class T, class F>
+static bool parse_array(const std::string_view val, ccl_arena* arena, ccl_str& out, F&& parse)
+{
+    auto begin = val.data();
+    const auto end = begin + val.length();
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        begin++;
+    if (begin == end)
+        return true;
+
+    const auto count = static_cast<size_t>(std::count(begin, end, ',')) + 1;
+    static_assert(alignof(T) <= 8, "Copies are only aligned to 8 bytes");
+    const auto elements = reinterpret_cast<T*>(out.reset(count * sizeof(T), arena));
+    return parse_list(begin, end, elements, count, parse);
+}
+
+bool ccl_data::parse_value(const std::string_view val, const data_type t)
+{
+    const auto begin = val.data();
+    const auto end = begin + val.length();
+    auto pos = begin;
+    auto result = true;
+
+    m_type_ = t;
+    m_raw_ = raw_none;
+    m_string_.clear(m_arena_);
+    m_value_ = value();
+
+    switch (t)
+    {
+    case ccl_type_int:
+        result = parse_int(pos, end, m_value_.i);
+        break;
+    case ccl_type_float:
+        result = parse_real(pos, end, m_value_.f);
+        break;
+    case ccl_type_int64:
+        result = parse_int64(pos, end, m_value_.l);
+        break;
+    case ccl_type_double:
+        result = parse_real(pos, end, m_value_.d);
+        break;
+    case ccl_type_bool:
+        {
+            auto b = 0;
+            result = parse_int(pos, end, b);
+            m_value_.b = b == 1;
+        }
+        break;
+    case ccl_type_point:
+        result = parse_ints(begin, end, &m_value_.point.x, 2);
+        break;
+    case ccl_type_rect:
+        result = parse_ints(begin, end, &m_value_.rect.x, 4);
+        break;
+    /* Lambdas, so the element parsers can be inlined */
+    case ccl_type_int_array:
+        result = parse_array<int>(val, m_arena_, m_string_,
+            [](const char*& p, const char* e, int& out) { return parse_int_swar(p, e, out); });
+        break;
+    case ccl_type_float_array:
+        result = parse_array<float>(val, m_arena_, m_string_,
+            [](const char*& p, const char* e, float& out) { return parse_real(p, e, out); });
+        break;
+    case ccl_type_string:
+        /* Only referenced, callers copy if needed */
+        m_string_.reference(val);
+        break;
+    default:
+        result = false;
+    }
+
+    if (!result)
+    {
+        m_value_ = value();
+        m_string_.clear(m_arena_);
+    }
+    return result;
+}
+
+bool ccl_data::parse_text(const std::string_view val, const data_type t, const bool escaped)
+{
+    if (t != ccl_type_string || !escaped || val.find("\\n") == std::string_view::npos)
+        return parse_value(val, t);
+
+    /* Escaped line breaks need their own copy */
+    std::string unescaped;
+    unescaped.reserve(val.length());
+    for (size_t i = 0; i < val.length(); i++)
+    {
+        if (val[i] == '\\' && i + 1 < val.length() && val[i + 1] == 'n')
+        {
+            unescaped += '\n';
+            i++;
+        }
+        else
+        {
+            unescaped += val[i];
+        }
+    }
+
+    m_type_ = t;
+    m_raw_ = raw_none;
+    store(m_string_, unescaped);
+    return true;
+}
+
+void ccl_data::set_raw(const std::string_view val, const data_type t, const bool escaped)
+{
+    m_type_ = t;
+    m_raw_ = escaped ? raw_escaped : raw_text;
+    reference(m_string_, val);
+}
+
+bool ccl_data::parse_raw() const
+{
+    /* Copies are copied again first, parsing frees m_string_ */
+    auto raw = m_string_.view();
+    std::string copy;
+    if (!m_string_.referenced())
+    {
+        copy.assign(raw);
+        raw = copy;
+    }
+    const auto escaped = m_raw_ == raw_escaped;
+    /* Nodes are never const themselves, only their accessors */
+    return const_cast<ccl_data*>(this)->parse_text(raw, m_type_, escaped);
+}
+
+void ccl_data::copy_value(const ccl_data& other)
+{
+    m_type_ = other.m_type_;
+    m_raw_ = other.m_raw_;
+    m_value_ = other.m_value_;
+    if (other.m_raw_ == raw_none && !other.m_string_.referenced()
+        && (m_type_ == ccl_type_int_array || m_type_ == ccl_type_float_array))
+        store_array(m_type_, other.m_string_.view().data(), other.m_string_.view().length());
+    else
+        copy_str(m_string_, other.m_string_);
+}
+
+void ccl_data::store_array(const data_type t, const void* data, const size_t size)
+{
+    static_assert(alignof(int) == alignof(float), "Arrays are stored with the same alignment");
+
+    m_type_ = t;
+    m_raw_ = raw_none;
+    m_value_ = value();
+    /* Arena copies are aligned to 8 bytes, heap copies for any type */
+    m_string_.assign({ static_cast<const char*>(data), size }, m_arena_);
+}
+
+template <class T>
+ccl_span<const T> ccl_data::array_of() const
+{
+    const auto bytes = m_string_.view();
+    return { reinterpret_cast<const T*>(bytes.data()), bytes.length() / sizeof(T) };
+}
+
+void ccl_data::copy_str(ccl_str& str, const ccl_str& other)
+{
+    /* Only copy strings that could go away with their node */
+    if (!other.referenced())
+    {
+        share(str, other.view());
+    }
+    else
+    {
+        str.clear(m_arena_);
+        str = other;
+    }
+}
+
+/* Parses the number after '0x' in a string, zero if there is none */
+static int hex_value(const std::string_view value)
+{
+    const auto prefix = value.find("0x");
+    if (prefix == std::string_view::npos)
+        return 0x0;
+
+    unsigned long hex = 0;
+    std::from_chars(value.data() + prefix + 2, value.data() + value.length(), hex, 16);
+    return static_cast<int>(hex);
+}
+
+/* Appends count integers separated by commas */
+static void append_ints(std::string& out, const int* values, const size_t count)
+{
+    char buf[16];
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i > 0)
+            out.push_back(',');
+        const auto result = std::to_chars(buf, buf + sizeof(buf), values[i]);
+        out.append(buf, result.ptr - buf);
+    }
+}
+
+void ccl_data::append_value(std::string& out, const bool escape) const
+{
+    resolve();
+    switch (m_type_)
+    {
+    case ccl_type_int:
+        append_ints(out, &m_value_.i, 1);
+        break;
+    case ccl_type_float:
+        append_real(out, m_value_.f);
+        break;
+    case ccl_type_int64:
+        {
+            char buf[24];
+            const auto result = std::to_chars(buf, buf + sizeof(buf), m_value_.l);
+            out.append(buf, result.ptr - buf);
+        }
+        break;
+    case ccl_type_double:
+        append_real(out, m_value_.d);
+        break;
+    case ccl_type_bool:
+        out.push_back(m_value_.b ? '1' : '0');
+        break;
+    case ccl_type_point:
+        append_ints(out, &m_value_.point.x, 2);
+        break;
+    case ccl_type_rect:
+        append_ints(out, &m_value_.rect.x, 4);
+        break;
+    case ccl_type_int_array:
+        {
+            const auto elements = array_of<int>();
+            append_ints(out, elements.data(), elements.size());
+        }
+        break;
+    case ccl_type_float_array:
+        {
+            const auto elements = array_of<float>();
+            for (size_t i = 0; i < elements.size(); i++)
+            {
+                if (i > 0)
+                    out.push_back(',');
+                append_real(out, elements[i]);
+            }
+        }
+        break;
+    default:
+        if (escape)
+        {
+            /* Line breaks are stored as '\\n' in files */
+            const auto str = m_string_.view();
+            size_t start = 0, pos;
+            while ((pos = str.find('\n', start)) != std::string_view::npos)
+            {
+                out.append(str.substr(start, pos - start));
+                out.append("\\n");
+                start = pos + 1;
+            }
+            out.append(str.substr(start));
+        }
+        else
+        {
+            out.append(m_string_.view());
+        }
+    }
+}
+
+void ccl_data::store(ccl_str& str, const std::string_view val)
+{
+    str.assign(val, m_arena_);
+}
+
+void ccl_data::share(ccl_str& str, const std::string_view val)
+{
+    /* Interned strings are shared, so they're never modified in place */
+    if (m_arena_ && m_arena_->interning())
+        reference(str, m_arena_->intern(val));
+    else
+        store(str, val);
+}
+
+void ccl_data::reference(ccl_str& str, const std::string_view val)
+{
+    str.clear(m_arena_);
+    str.reference(val);
+}
+
+ccl_data* ccl_index::find(const std::string_view id) const
+{
+    return find(id, hash(id.data(), id.length()));
+}
+
+ccl_data* ccl_index::find(const std::string_view id, const uint64_t h) const
+{
+    if (m_slots_.empty())
+        return nullptr;
+
+    const auto mask = m_slots_.size() - 1;
+    auto i = h & mask;
+
+    while (m_slots_[i].node)
+    {
+        if (m_slots_[i].hash == h && m_slots_[i].node->m_id_.view() == id)
+            return m_slots_[i].node;
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+void ccl_index::prefetch(const uint64_t h) const
+{
+#if defined(__GNUC__) || defined(__clang__)
+    if (!m_slots_.empty())
+        __builtin_prefetch(&m_slots_[h & (m_slots_.size() - 1)]);
+#else
+    (void)h;
+#endif
+}
+
+void ccl_index::insert(ccl_data* node)
+{
+    /* Keep load factor below 0.75 */
+    if ((m_size_ + 1) * 4 > m_slots_.size() * 3)
+        rehash(m_slots_.empty() ? 16 : m_slots_.size() * 2);
+
+    const auto id = node->m_id_.view();
+    const auto h = hash(id.data(), id.length());
+    const auto mask = m_slots_.size() - 1;
+    auto i = h & mask;
+
+    while (m_slots_[i].node)
+        i = (i + 1) & mask;
+
+    m_slots_[i] = { h, node };
+    m_size_++;
+}
+
+void ccl_index::erase(const ccl_data* node)
+{
+    if (m_slots_.empty())
+        return;
+
+    const auto id = node->m_id_.view();
+    const auto mask = m_slots_.size() - 1;
+    auto i = hash(id.data(), id.length()) & mask;
+
+    while (m_slots_[i].node && m_slots_[i].node != node)
+        i = (i + 1) & mask;
+    if (!m_slots_[i].node)
+        return;
+
+    /* Move following entries back, so no probe sequence is interrupted */
+    for (auto j = (i + 1) & mask; m_slots_[j].node; j = (j + 1) & mask)
+    {
+        const auto ideal = m_slots_[j].hash & mask;
+        const auto distance_j = (j - ideal) & mask;
+        const auto distance_i = (i - ideal) & mask;
+        if (distance_i < distance_j)
+        {
+            m_slots_[i] = m_slots_[j];
+            i = j;
+        }
+    }
+    m_slots_[i] = { 0, nullptr };
+    m_size_--;
+}
+
+void ccl_index::clear()
+{
+    m_slots_.clear();
+    m_size_ = 0;
+}
+
+size_t ccl_index::size() const
+{
+    return m_size_;
+}
+
+void ccl_index::reserve(const size_t count)
+{
+    auto size = m_slots_.empty() ? 16 : m_slots_.size();
+    while (count * 4 > size * 3)
+        size *= 2;
+    if (size != m_slots_.size())
+        rehash(size);
+}
+
+void ccl_index::rehash(const size_t size)
+{
+    std::vector<slot> old;
+    old.swap(m_slots_);
+    m_slots_.assign(size, { 0, nullptr });
+
+    const auto mask = m_slots_.size() - 1;
+    for (const auto& s : old)
+    {
+        if (!s.node)
+            continue;
+        auto i = s.hash & mask;
+        while (m_slots_[i].node)
+            i = (i + 1) & mask;
+        m_slots_[i] = s;
+    }
+}
+
+uint64_t ccl_snapshot::get_version() const
+{
+    return m_version_;
+}
+
+const ccl_data* ccl_snapshot::get_first() const
+{
+    return m_first_node_;
+}
+
+const ccl_data* ccl_snapshot::get_node(const std::string_view id) const
+{
+    return m_index_.find(id);
+}
+
+bool ccl_snapshot::node_exists(const std::string_view id) const
+{
+    return m_index_.find(id) != nullptr;
+}
+
+int ccl_snapshot::get_int(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_int() : 0;
+}
+
+int ccl_snapshot::get_hex(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node && node->m_type_ == ccl_type_string ? hex_value(node->m_string_.view()) : 0;
+}
+
+float ccl_snapshot::get_float(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_float() : 0.f;
+}
+
+int64_t ccl_snapshot::get_int64(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_int64() : 0;
+}
+
+double ccl_snapshot::get_double(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_double() : 0.0;
+}
+
+bool ccl_snapshot::get_bool(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node && node->get_bool();
+}
+
+std::string ccl_snapshot::get_string(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_value() : "";
+}
+
+std::string_view ccl_snapshot::get_string_view(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_string() : std::string_view();
+}
+
+int ccl_snapshot::get_point_x(const std::string_view id) const
+{
+    return get_point(id).x;
+}
+
+int ccl_snapshot::get_point_y(const std::string_view id) const
+{
+    return get_point(id).y;
+}
+
+int ccl_snapshot::get_rect_x(const std::string_view id) const
+{
+    return get_rect(id).x;
+}
+
+int ccl_snapshot::get_rect_y(const std::string_view id) const
+{
+    return get_rect(id).y;
+}
+
+int ccl_snapshot::get_rect_w(const std::string_view id) const
+{
+    return get_rect(id).w;
+}
+
+int ccl_snapshot::get_rect_h(const std::string_view id) const
+{
+    return get_rect(id).h;
+}
+
+ccl_point ccl_snapshot::get_point(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_point() : ccl_point();
+}
+
+ccl_rect ccl_snapshot::get_rect(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_rect() : ccl_rect();
+}
+
+ccl_span<const int> ccl_snapshot::get_int_array(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_int_array() : ccl_span<const int>();
+}
+
+ccl_span<const float> ccl_snapshot::get_float_array(const std::string_view id) const
+{
+    const auto node = m_index_.find(id);
+    return node ? node->get_float_array() : ccl_span<const float>();
+}
+
+/* Hazard pointers of all readers. A reader takes a free slot and
+   stores the snapshot it reads in it, writers only free snapshots
+   which aren't in any slot. If all slots are taken, another block
+   of them is added. Blocks are never freed */
+#define CCL_HAZARD_SLOTS 128
+
+struct alignas(64) ccl_hazard_slot
+{
+    std::atomic<bool> used{ false };
+    std::atomic<const ccl_snapshot*> snapshot{ nullptr };
+};
+
+struct hazard_block
+{
+    ccl_hazard_slot slots[CCL_HAZARD_SLOTS];
+    hazard_block* next = nullptr;
+};
+
+static hazard_block first_hazard_block;
+static std::atomic<hazard_block*> hazard_blocks{ &first_hazard_block };
+
+static bool claim_slot(ccl_hazard_slot& slot)
+{
+    auto expected = false;
+    return !slot.used.load(std::memory_order_relaxed)
+        && slot.used.compare_exchange_strong(expected, true, std::memory_order_acquire);
+}
+
+static ccl_hazard_slot* claim_slot()
+{
+    /* Start with the slot this thread had last time */
+    static thread_local ccl_hazard_slot* hint = nullptr;
+    if (hint && claim_slot(*hint))
+        return hint;
+
+    for (auto block = hazard_blocks.load(std::memory_order_acquire); block; block = block->next)
+    {
+        for (auto& slot : block->slots)
+        {
+            if (claim_slot(slot))
+                return hint = &slot;
+        }
+    }
+
+    /* Everything is taken, add a block with the first slot claimed */
+    const auto block = new hazard_block();
+    block->slots[0].used.store(true, std::memory_order_relaxed);
+    block->next = hazard_blocks.load(std::memory_order_relaxed);
+    /* Ordered with the writer's scan like the slots themselves */
+    while (!hazard_blocks.compare_exchange_weak(block->next, block, std::memory_order_seq_cst))
+    {
+    }
+    return hint = &block->slots[0];
+}
+
+ccl_snapshot_ref::ccl_snapshot_ref(const std::atomic<ccl_snapshot*>& source)
+{
+    m_slot_ = claim_slot();
+
+    /* The snapshot is only safe to use if it's still the current one
+       after announcing it, otherwise it might already be retired */
+    const ccl_snapshot* current;
+    do
+    {
+        current = source.load(std::memory_order_seq_cst);
+        m_slot_->snapshot.store(current, std::memory_order_seq_cst);
+    } while (current != source.load(std::memory_order_seq_cst));
+
+    m_snapshot_ = current;
+}
+
+ccl_snapshot_ref::ccl_snapshot_ref(ccl_snapshot_ref&& other) noexcept
+{
+    m_snapshot_ = other.m_snapshot_;
+    m_slot_ = other.m_slot_;
+    other.m_snapshot_ = nullptr;
+    other.m_slot_ = nullptr;
+}
+
+ccl_snapshot_ref::~ccl_snapshot_ref()
+{
+    if (m_slot_)
+    {
+        m_slot_->snapshot.store(nullptr, std::memory_order_release);
+        m_slot_->used.store(false, std::memory_order_release);
+    }
+}
+
+ccl_buffer::~ccl_buffer()
+{
+    close();
+}
+
+bool ccl_buffer::open(const ccl_path& path, const bool map)
+{
+    close();
+#ifdef _WIN32
+    const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    auto result = GetFileSizeEx(file, &size) != 0;
+    m_size_ = result ? static_cast<size_t>(size.QuadPart) : 0;
+
+    if (result && m_size_ > 0)
+    {
+        if (map)
+        {
+            /* The view keeps the mapping alive, so both handles can be closed */
+            const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY,
+                0, 0, nullptr);
+            m_data_ = mapping ? static_cast<char*>(MapViewOfFile(mapping,
+                FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            m_mapped_ = m_data_ != nullptr;
+            if (mapping)
+                CloseHandle(mapping);
+        }
+        else
+        {
+            DWORD read = 0;
+            m_data_ = new char[m_size_];
+            /* Config files bigger than 4GB aren't supported when reading */
+            result = ReadFile(file, m_data_, static_cast<DWORD>(m_size_), &read,
+                nullptr) && read == m_size_;
+        }
+        result = result && m_data_;
+    }
+    CloseHandle(file);
+#else
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat st = {};
+    auto result = fstat(fd, &st) == 0;
+    m_size_ = result ? static_cast<size_t>(st.st_size) : 0;
+
+    if (result && m_size_ > 0)
+    {
+        if (map)
+        {
+            const auto addr = mmap(nullptr, m_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            result = addr != MAP_FAILED;
+            if (result)
+            {
+                m_data_ = static_cast<char*>(addr);
+                m_mapped_ = true;
+            }
+        }
+        else
+        {
+            m_data_ = new char[m_size_];
+            size_t done = 0;
+            while (result && done < m_size_)
+            {
+                const auto n = read(fd, m_data_ + done, m_size_ - done);
+                result = n > 0;
+                done += result ? static_cast<size_t>(n) : 0;
+            }
+        }
+    }
+    ::close(fd);
+#endif
+    if (!result)
+        close();
+    return result;
+}
+
+void ccl_buffer::assign(const char* data, const size_t size)
+{
+    close();
+    if (size > 0)
+    {
+        m_data_ = new char[size];
+        m_size_ = size;
+        memcpy(m_data_, data, size);
+    }
+}
+
+void ccl_buffer::close()
+{
+    if (m_mapped_)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data_);
+#else
+        munmap(m_data_, m_size_);
+#endif
+    }
+    else
+    {
+        delete[] m_data_;
+    }
+    m_data_ = nullptr;
+    m_size_ = 0;
+    m_mapped_ = false;
+}
+
+ccl_config::ccl_config()
+{
+    m_empty_ = true;
+    m_first_node_ = nullptr;
+    m_header_ = "";
+#ifdef _MSC_VER
+    m_path_ = L"";
+#else
+	m_path_ = "";
+#endif
+}
+
+ccl_config::ccl_config(const std::string& path, std::string header,
+    const unsigned flags)
+{
+    m_empty_ = true;
+    m_flags_ = flags;
+    m_arena_.set_interning((flags & ccl_load_intern) != 0);
+    m_first_node_ = nullptr;
+    m_header_ = std::move(header);
+#ifdef _MSC_VER
+    m_path_ = to_utf_16(path);
+#else
+	m_path_ = path;
+#endif
+
+    load();
+}
+
+#ifdef _MSC_VER
+ccl_config::ccl_config(std::wstring path, std::string header,
+    const unsigned flags)
+{
+    m_empty_ = true;
+    m_flags_ = flags;
+    m_arena_.set_interning((flags & ccl_load_intern) != 0);
+    m_first_node_ = nullptr;
+    m_header_ = std::move(header);
+    m_path_ = std::move(path);
+    load();
+}
+#endif
+
+ccl_config::~ccl_config()
+{
+    if (m_journal_)
+        fclose(m_journal_);
+    watch(false);
+
+    /* Readers have to be done by now, but wait for them just in case */
+    const auto current = m_snapshot_.exchange(nullptr);
+    if (current)
+        m_retired_snapshots_.push_back(current);
+    reclaim_snapshots(true);
+    if (!m_empty_)
+        free_nodes();
+    m_empty_ = true;
+    m_header_ = "";
+    m_path_.clear();
+}
+
+void ccl_config::free_nodes()
+{
+    /* Arena nodes are freed all at once, only look
+       for heap nodes if there are any */
+    auto node = m_heap_nodes_ > 0 ? m_first_node_ : nullptr;
+    ccl_data* next = nullptr;
+
+    while (node)
+    {
+        next = node->get_next();
+        if (!node->m_arena_)
+            delete node;
+        node = next;
+    }
+    m_first_node_ = nullptr;
+    m_heap_nodes_ = 0;
+    m_empty_ = true;
+    m_generation_++;
+    m_revision_++;
+    m_index_.clear();
+    m_arena_.reset();
+    m_buffers_.clear();
+    m_written_.reset();
+    m_source_ = nullptr;
+}
+
+void ccl_config::load()
+{
+    CCL_COUNT(loads, 1);
+    CCL_TIME(load_ns);
+
+    if (can_load())
+    {
+        std::unique_ptr<ccl_buffer> buffer(new ccl_buffer());
+
+        /* The cache is only checked against the file, so map it */
+        const auto cache = (m_flags_ & ccl_load_cache) && !m_first_node_;
+
+        if (buffer->open(m_path_, cache || (m_flags_ & ccl_load_mapped)))
+        {
+            if (!cache || !load_cache(*buffer))
+            {
+                CCL_COUNT(bytes_read, buffer->size());
+                const auto errors = m_error_count_;
+                m_loading_ = true;
+                parse(buffer->data(), buffer->data() + buffer->size());
+                m_loading_ = false;
+
+                /* Errors would get lost, so only cache files without */
+                if (cache && m_error_count_ == errors)
+                    write_cache(*buffer);
+            }
+            /* Nodes reference the buffer */
+            set_source(buffer.get());
+            m_buffers_.push_back(std::move(buffer));
+        }
+        else
+        {
+            add_error(ccl_error_file_access, ccl_error_normal);
+        }
+    }
+
+    if (m_flags_ & ccl_load_journal)
+        replay_journal();
+
+    check_schema();
+
+    if (m_first_node_)
+    {
+        m_empty_ = false;
+    }
+}
+
+void ccl_config::set_flags(const unsigned flags)
+{
+    m_flags_ = flags;
+    m_arena_.set_interning((flags & ccl_load_intern) != 0);
+}
+
+unsigned ccl_config::get_flags() const
+{
+    return m_flags_;
+}
+
+/* Bit masks of the structural characters in 64 bytes of text,
+   bit i is set if byte i is that character */
+struct block_mask
+{
+    uint64_t newline;
+    uint64_t separator;
+    uint64_t escape;
+};
+
+/* Only needed if there is no SSE2 to fall back on */
+#ifndef CCL_SSE2
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static void classify_scalar(const char* p, block_mask& m)
+{
+    m = {};
+    for (auto i = 0; i < 64; i++)
+    {
+        const uint64_t bit = 1ull << i;
+        m.newline |= p[i] == '\n' ? bit : 0;
+        m.separator |= p[i] == '=' ? bit : 0;
+        m.escape |= p[i] == '\\' ? bit : 0;
+    }
+}
+#else
+/* Bit i is set if byte i of the little endian word is c */
+static inline uint64_t match_word(const uint64_t word, const char c)
+{
+    const auto x = word ^ (0x0101010101010101ull * static_cast<unsigned char>(c));
+    /* High bit of each byte set if the byte is zero, without false positives */
+    const auto zero = ~(((x & 0x7f7f7f7f7f7f7f7full) + 0x7f7f7f7f7f7f7f7full) | x)
+        & 0x8080808080808080ull;
+    return ((zero >> 7) * 0x0102040810204080ull) >> 56;
+}
+
+/* Eight bytes at a time, for CPUs without SSE2 */
+static void classify_scalar(const char* p, block_mask& m)
+{
+    m = {};
+    for (auto i = 0; i < 64; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        m.newline |= match_word(word, '\n') << i;
+        m.separator |= match_word(word, '=') << i;
+        m.escape |= match_word(word, '\\') << i;
+    }
+}
+#endif
+#endif
+
+#ifdef CCL_SSE2
+static void classify_sse2(const char* p, block_mask& m)
+{
+    const auto newline = _mm_set1_epi8('\n');
+    const auto separator = _mm_set1_epi8('=');
+    const auto escape = _mm_set1_epi8('\\');
+    m = {};
+
+    for (auto i = 0; i < 64; i += 16)
+    {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        m.newline |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)))) << i;
+        m.separator |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, separator)))) << i;
+        m.escape |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, escape)))) << i;
+    }
+}
+#endif
+
+#ifdef CCL_AVX2
+CCL_TARGET_AVX2 static uint64_t match_avx2(const __m256i lo, const __m256i hi, const char c)
+{
+    const auto v = _mm256_set1_epi8(c);
+    const uint64_t a = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v)));
+    const uint64_t b = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v)));
+    return a | b << 32;
+}
+
+CCL_TARGET_AVX2 static void classify_avx2(const char* p, block_mask& m)
+{
+    const auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    m.newline = match_avx2(lo, hi, '\n');
+    m.separator = match_avx2(lo, hi, '=');
+    m.escape = match_avx2(lo, hi, '\\');
+}
+
+static bool has_avx2()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+        return false;
+    /* The OS has to save the AVX registers as well */
+    __cpuid(regs, 1);
+    if (!(regs[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+typedef void (*classify_fn)(const char* p, block_mask& m);
+
+/* Picks the fastest classifier this CPU supports */
+static classify_fn select_classify()
+{
+#ifdef CCL_AVX2
+    if (has_avx2())
+        return classify_avx2;
+#endif
+#ifdef CCL_SSE2
+    return classify_sse2;
+#else
+    return classify_scalar;
+#endif
+}
+
+/* Selected on first use instead of during static initialization,
+   which configs loaded by other static objects could run before */
+static classify_fn classifier()
+{
+    static const classify_fn classify = select_classify();
+    return classify;
+}
+
+/* Line found by line_scanner, without the line break */
+struct scanned_line
+{
+    const char* begin;
+    const char* end;
+    /* First '=' in the line, null if there is none */
+    const char* separator;
+    /* True if the line contains a backslash */
+    bool escaped;
+};
+
+/* Splits text into lines. Each 64 byte block is classified once,
+   which gives the line breaks, '=' and backslashes in it, so
+   lines don't have to be searched for them again */
+class line_scanner
+{
+public:
+    line_scanner(const char* begin, const char* end)
+        : m_block_(begin), m_pos_(begin), m_end_(end), m_classify_(classifier())
+    {
+        load();
+    }
+
+    /* False once the end of the text is reached */
+    bool next(scanned_line& line)
+    {
+        if (m_pos_ >= m_end_)
+            return false;
+
+        line.begin = m_pos_;
+        line.separator = nullptr;
+        line.escaped = false;
+
+        for (;;)
+        {
+            const auto offset = m_pos_ - m_block_;
+            const auto rest = offset < 64 ? ~0ull << offset : 0;
+            const auto newline = m_mask_.newline & rest;
+            /* Bits up to the line break, or the whole block */
+            const auto range = rest & (newline ? (newline & (0 - newline)) - 1 : ~0ull);
+
+            if (!line.separator && (m_mask_.separator & range))
+                line.separator = m_block_ + lowest_bit(m_mask_.separator & range);
+            if (m_mask_.escape & range)
+                line.escaped = true;
+
+            if (newline)
+            {
+                line.end = m_block_ + lowest_bit(newline);
+                m_pos_ = line.end + 1;
+                break;
+            }
+
+            m_block_ += 64;
+            m_pos_ = m_block_;
+            if (m_block_ >= m_end_)
+            {
+                line.end = m_end_;
+                m_pos_ = m_end_;
+                break;
+            }
+            load();
+        }
+
+        if (line.end > line.begin && line.end[-1] == '\r')
+            line.end--;
+        return true;
+    }
+private:
+    void load()
+    {
+        if (m_end_ - m_block_ >= 64)
+        {
+            m_classify_(m_block_, m_mask_);
+        }
+        else if (m_block_ < m_end_)
+        {
+            /* Zeros aren't structural, so the rest of the block stays empty */
+            char tail[64] = {};
+            memcpy(tail, m_block_, m_end_ - m_block_);
+            m_classify_(tail, m_mask_);
+        }
+    }
+
+    const char* m_block_;
+    const char* m_pos_;
+    const char* m_end_;
+    classify_fn m_classify_;
+    block_mask m_mask_ = {};
+};
+
+/* Start of the line before the one starting at pos */
+static size_t previous_line(const char* text, size_t pos)
+{
+    pos--;
+    while (pos > 0 && text[pos - 1] != '\n')
+        pos--;
+    return pos;
+}
+
+/* Runs fn(0) to fn(count - 1) on their own threads */
+template <class F>
+static void parallel_for(const size_t count, F&& fn)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    for (size_t i = 1; i < count; i++)
+        threads.emplace_back([&fn, i] { fn(i); });
+    fn(0);
+    for (auto& t : threads)
+        t.join();
+}
+
+/* Removes the '# ' in front of comments */
+inline std::string_view strip_comment(const std::string_view line)
+{
+    return line.substr(line.length() < 2 ? line.length() : 2);
+}
+
+template <class R, class F>
+int ccl_parser::tokenize(const char* begin, const char* end, int line,
+    std::string_view* header, R&& report, F&& on_entry)
+{
+    line_scanner scanner(begin, end);
+    scanned_line s;
+
+    if (header && begin < end && *begin == '#')
+    {
+        scanner.next(s);
+        *header = strip_comment({ s.begin, static_cast<size_t>(s.end - s.begin) });
+        line++;
+    }
+#ifdef _DEBUG
+    /* Another redundant error */
+    else if (header && begin < end && *begin != '\n' && *begin != '\r')
+    {
+        report(ccl_error_header, line, 0);
+    }
+#endif
+
+    /* Last comment in front of the current line */
+    ccl_entry e = {};
+
+    for (; scanner.next(s); line++)
+    {
+        const std::string_view l(s.begin, static_cast<size_t>(s.end - s.begin));
+
+        if (l.empty())
+        {
+#if _DEBUG /* This error is redundant */
+            report(ccl_error_empty_line, line, 0);
+#endif
+            e.comment = {};
+            e.has_comment = false;
+            continue;
+        }
+
+        if (l[0] == '#')
+        {
+            e.comment = strip_comment(l);
+            e.has_comment = true;
+            continue;
+        }
+
+        /* Read in the value type */
+        e.type = util_parse_type(l[0]);
+
+        if (e.type == ccl_type_invalid)
+        {
+            report(ccl_error_invalid_type, line, l[0]);
+            e.comment = {};
+            e.has_comment = false;
+            continue;
+        }
+
+        const auto text = l.substr(l.length() < 2 ? l.length() : 2);
+        auto separator = std::string_view::npos;
+
+        /* The separator can't be part of the type prefix */
+        if (s.separator && s.separator >= text.data() && s.separator < s.end)
+            separator = s.separator - text.data();
+        else if (s.separator)
+            separator = text.find('=');
+
+        if (separator == std::string_view::npos)
+        {
+            report(ccl_error_missing_separator, line, 0);
+            e.comment = {};
+            e.has_comment = false;
+            continue;
+        }
+
+        e.id = text.substr(0, separator);
+        e.value = text.substr(separator + 1);
+        e.escaped = s.escaped;
+        e.line = line;
+        on_entry(static_cast<const ccl_entry&>(e));
+
+        e.comment = {};
+        e.has_comment = false;
+    }
+    return line;
+}
+
+ccl_parser::ccl_parser(const size_t block_size)
+    : m_block_size_(std::max<size_t>(block_size, 64))
+{
+}
+
+void ccl_parser::set_error_handler(const error_fn fn, void* user)
+{
+    m_error_fn_ = fn;
+    m_error_user_ = user;
+}
+
+bool ccl_parser::parse_file(const ccl_path& path, const entry_fn fn, void* user)
+{
+#ifdef _WIN32
+    const auto file = _wfopen(path.c_str(), L"rb");
+#else
+    const auto file = fopen(path.c_str(), "rb");
+#endif
+    if (!file)
+        return false;
+
+    const auto result = parse_stream(file, fn, user);
+    fclose(file);
+    return result;
+}
+
+bool ccl_parser::parse_stream(FILE* stream, const entry_fn fn, void* user)
+{
+    const auto report = [this](const error_code code, const int line, const int detail)
+    {
+        if (m_error_fn_)
+            m_error_fn_(code, line, detail, m_error_user_);
+    };
+    const auto on_entry = [fn, user](const ccl_entry& e) { fn(e, user); };
+
+    std::vector<char> block(m_block_size_);
+    size_t used = 0;
+    auto line = 1;
+    auto first = true;
+    auto done = false;
+    m_header_.clear();
+
+    while (!done)
+    {
+        /* The rest of the block is one line (or comment and entry) */
+        if (used == block.size())
+            block.resize(block.size() * 2);
+
+        const auto wanted = block.size() - used;
+        const auto read = fread(block.data() + used, 1, wanted, stream);
+        if (read < wanted)
+        {
+            if (ferror(stream))
+                return false;
+            done = true;
+        }
+        used += read;
+
+        /* Only complete lines are read, comments stay with their entry */
+        const auto begin = block.data();
+        auto end = begin + used;
+        if (!done)
+        {
+            while (end > begin && end[-1] != '\n')
+                end--;
+            while (end > begin && begin[previous_line(begin, end - begin)] == '#')
+                end = begin + previous_line(begin, end - begin);
+            if (end == begin)
+                continue;
+        }
+
+        std::string_view header;
+        line = tokenize(begin, end, line, first ? &header : nullptr, report, on_entry);
+        if (header.data())
+            m_header_ = std::string(header);
+        first = false;
+
+        used -= end - begin;
+        memmove(begin, end, used);
+    }
+    return true;
+}
+
+void ccl_parser::parse_text(const std::string_view text, const entry_fn fn, void* user)
+{
+    const auto report = [this](const error_code code, const int line, const int detail)
+    {
+        if (m_error_fn_)
+            m_error_fn_(code, line, detail, m_error_user_);
+    };
+
+    std::string_view header;
+    tokenize(text.data(), text.data() + text.length(), 1, &header, report,
+        [fn, user](const ccl_entry& e) { fn(e, user); });
+    m_header_ = std::string(header);
+}
+
+const std::string& ccl_parser::get_header() const
+{
+    return m_header_;
+}
+
+/* Calls report(code, line, detail) for lines that couldn't be read */
+#define CCL_REPORT_ERRORS [this](const error_code code, const int line, const int detail) \
+    { add_error(code, ccl_error_normal, {}, line, detail); }
+#define CCL_IGNORE_ERRORS [](error_code, int, int) {}
+
+void ccl_config::parse(const char* begin, const char* end, const bool replay)
+{
+    if (!replay && (m_flags_ & ccl_load_parallel) && parse_parallel(begin, end))
+        return;
+
+    std::string_view header;
+    uint64_t entries = 0;
+
+    /* Journals don't have a header */
+    ccl_parser::tokenize(begin, end, 1, replay ? nullptr : &header, CCL_REPORT_ERRORS,
+        [&](const ccl_entry& e)
+    {
+        entries++;
+        const auto new_node = m_arena_.create<ccl_data>();
+        new_node->m_arena_ = &m_arena_;
+        new_node->m_id_.reference(e.id);
+        new_node->m_comment_.reference(loaded_comment(e.comment));
+        if (!read_value(new_node, e))
+            add_error(ccl_error_invalid_value, ccl_error_normal, e.id, e.line);
+
+        if (replay)
+        {
+            /* Records without comment only change the value */
+            const auto existing = m_index_.find(e.id);
+            if (existing && !e.has_comment)
+                new_node->copy_str(new_node->m_comment_, existing->m_comment_);
+            add_node(new_node, true);
+        }
+        else
+        {
+            add_node(new_node);
+        }
+    });
+    CCL_COUNT(entries_parsed, entries);
+
+    if (header.data())
+        m_header_ = std::string(header);
+}
+
+/* Part of a file parsed by one thread */
+struct ccl_chunk
+{
+    const char* begin;
+    const char* end;
+    int line;
+    ccl_arena arena;
+    std::vector<ccl_data*> nodes;
+    /* Line of each node, so errors can be merged in order */
+    std::vector<int> lines;
+    std::vector<ccl_error> errors;
+};
+
+bool ccl_config::parse_parallel(const char* begin, const char* end)
+{
+    /* Chunks should be big enough to be worth a thread */
+    const size_t min_chunk = 1 << 20;
+    const auto size = static_cast<size_t>(end - begin);
+    const auto threads = std::max(1u, std::thread::hardware_concurrency());
+    const auto count = std::min<size_t>(threads, size / min_chunk);
+
+    if (count < 2)
+        return false;
+
+    /* Split at line breaks, but never right after a comment,
+       because it belongs to the entry in the next line */
+    std::vector<const char*> splits = { begin };
+    for (size_t i = 1; i < count; i++)
+    {
+        auto pos = std::max(begin + size * i / count, splits.back());
+        do
+        {
+            const auto line_end = static_cast<const char*>(memchr(pos, '\n', end - pos));
+            pos = line_end ? line_end + 1 : end;
+        } while (pos < end && begin[previous_line(begin, pos - begin)] == '#');
+        if (pos < end && pos > splits.back())
+            splits.push_back(pos);
+    }
+    splits.push_back(end);
+
+    std::vector<ccl_chunk> chunks(splits.size() - 1);
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        chunks[i].begin = splits[i];
+        chunks[i].end = splits[i + 1];
+    }
+
+    /* Line numbers are only needed for errors, but
+       counting line breaks is cheap compared to parsing */
+    parallel_for(chunks.size(), [&](const size_t i)
+    {
+        chunks[i].line = static_cast<int>(std::count(chunks[i].begin, chunks[i].end, '\n'));
+    });
+    auto line = 1;
+    for (auto& c : chunks)
+    {
+        const auto lines = c.line;
+        c.line = line;
+        line += lines;
+    }
+
+    std::string_view header;
+    parallel_for(chunks.size(), [&](const size_t i)
+    {
+        auto& c = chunks[i];
+        const auto report = [&c](const error_code code, const int line, const int detail)
+        {
+            c.errors.push_back(make_error(code, ccl_error_normal, {}, line, detail));
+        };
+
+        ccl_parser::tokenize(c.begin, c.end, c.line, i == 0 ? &header : nullptr, report,
+            [&](const ccl_entry& e)
+        {
+            const auto node = c.arena.create<ccl_data>();
+            node->m_arena_ = &c.arena;
+            node->m_id_.reference(e.id);
+            node->m_comment_.reference(loaded_comment(e.comment));
+            if (!read_value(node, e))
+                c.errors.push_back(make_error(ccl_error_invalid_value, ccl_error_normal, e.id, e.line, 0));
+            c.nodes.push_back(node);
+            c.lines.push_back(e.line);
+        });
+    });
+
+    /* Merge in file order, so duplicates are handled like in serial loading */
+    size_t nodes = m_index_.size();
+    for (const auto& c : chunks)
+        nodes += c.nodes.size();
+    CCL_COUNT(entries_parsed, nodes - m_index_.size());
+    m_index_.reserve(nodes);
+
+    for (auto& c : chunks)
+    {
+        auto error = c.errors.begin();
+        for (size_t i = 0; i < c.nodes.size(); i++)
+        {
+            for (; error != c.errors.end() && error->line <= c.lines[i]; ++error)
+                add_error(*error);
+            c.nodes[i]->m_arena_ = &m_arena_;
+            add_node(c.nodes[i]);
+        }
+        for (; error != c.errors.end(); ++error)
+            add_error(*error);
+        m_arena_.adopt(c.arena);
+    }
+
+    if (header.data())
+        m_header_ = std::string(header);
+    return true;
+}
+
+bool ccl_config::read_value(ccl_data* node, const ccl_entry& e)
+{
+    /* Strings without escapes are only referenced, so there's nothing to defer */
+    if ((m_flags_ & ccl_load_lazy) && (e.type != ccl_type_string || e.escaped))
+    {
+        node->set_raw(e.value, e.type, e.escaped);
+        return true;
+    }
+    return node->parse_text(e.value, e.type, e.escaped);
+}
+
+/* Replaces the file at path with data. The data is written
+   to a temporary file first, which is then renamed, so the
+   file is never left half written */
+static bool replace_file(const ccl_path& path, const char* data, const size_t size)
+{
+#ifdef _WIN32
+    const auto temp = path + L".tmp";
+    const auto file = CreateFileW(temp.c_str(), GENERIC_WRITE, 0, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    auto result = true;
+    size_t done = 0;
+    while (result && done < size)
+    {
+        DWORD written = 0;
+        const auto chunk = static_cast<DWORD>(std::min<size_t>(size - done, 1 << 30));
+        result = WriteFile(file, data + done, chunk, &written, nullptr) && written > 0;
+        done += written;
+    }
+    result = result && FlushFileBuffers(file);
+    CloseHandle(file);
+
+    result = result && MoveFileExW(temp.c_str(), path.c_str(),
+        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    if (!result)
+        DeleteFileW(temp.c_str());
+#else
+    const auto temp = path + ".tmp";
+    const auto fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1)
+        return false;
+
+    auto result = true;
+    size_t done = 0;
+    while (result && done < size)
+    {
+        const auto n = ::write(fd, data + done, size - done);
+        result = n > 0 || (n == -1 && errno == EINTR);
+        done += n > 0 ? static_cast<size_t>(n) : 0;
+    }
+    result = result && fsync(fd) == 0;
+    result = ::close(fd) == 0 && result;
+
+    result = result && rename(temp.c_str(), path.c_str()) == 0;
+    if (!result)
+        unlink(temp.c_str());
+#endif
+    return result;
+}
+
+void ccl_config::serialize(std::string& out, const bool comments) const
+{
+    /* Estimate size up front, so the buffer rarely has to grow */
+    auto size = m_header_.length() + 3;
+    for (auto node = m_first_node_; node; node = node->m_next_)
+    {
+        size += node->m_id_.view().length() + node->m_string_.view().length() + 24;
+        /* Elements are stored in 4 bytes, but take up to 12 or 16 as text */
+        if (node->m_type_ == ccl_type_int_array)
+            size += node->m_string_.view().length() * 2;
+        else if (node->m_type_ == ccl_type_float_array)
+            size += node->m_string_.view().length() * 3;
+        if (comments && !node->m_comment_.empty())
+            size += node->m_comment_.view().length() + 3;
+    }
+    out.reserve(out.length() + size + size / 8);
+
+    if (comments)
+    {
+        out.append("# ");
+        out.append(m_header_);
+        out.push_back('\n');
+    }
+
+    for (auto node = m_first_node_; node; node = node->m_next_)
+    {
+        if (comments && !node->m_comment_.empty())
+        {
+            out.append("# ");
+            out.append(node->m_comment_.view());
+            out.push_back('\n');
+        }
+
+        out.push_back(static_cast<char>('0' + node->m_type_));
+        out.push_back('_');
+        out.append(node->m_id_.view());
+        out.push_back('=');
+        node->append_value(out, true);
+        out.push_back('\n');
+    }
+}
+
+void ccl_config::write(const bool comments)
+{
+    if (m_path_.empty())
+    {
+        return;
+    }
+
+    CCL_COUNT(writes, 1);
+    CCL_TIME(write_ns);
+
+    std::string buffer;
+    serialize(buffer, comments);
+
+    if (replace_file(m_path_, buffer.data(), buffer.length()))
+    {
+        CCL_COUNT(bytes_written, buffer.length());
+        /* Everything in the journal is part of the file now */
+        if (m_flags_ & ccl_load_journal)
+            clear_journal();
+
+        /* Changes are diffed against what was written, which
+           replaces the copy of the previous write. Older files
+           aren't needed for that anymore */
+        if (m_watching_)
+        {
+            release_buffers();
+            if (!m_written_)
+                m_written_.reset(new ccl_buffer());
+            m_written_->assign(buffer.data(), buffer.length());
+            set_source(m_written_.get());
+        }
+        else
+        {
+            m_source_outdated_ = true;
+        }
+    }
+    else
+    {
+        add_error(ccl_error_write, ccl_error_fatal);
+    }
+}
+
+void ccl_config::publish()
+{
+    auto count = 0;
+    for (auto node = m_first_node_; node; node = node->m_next_)
+        count++;
+
+    const auto snapshot = new ccl_snapshot();
+    snapshot->m_version_ = ++m_snapshot_version_;
+    snapshot->m_index_.reserve(count);
+    snapshot->m_arena_.set_interning(m_arena_.interning());
+
+    /* Copy everything, so the snapshot stays valid
+       when nodes or loaded files are freed */
+    ccl_data* last = nullptr;
+    for (auto node = m_first_node_; node; node = node->m_next_)
+    {
+        /* Readers can't parse values concurrently */
+        node->resolve();
+        const auto copy = snapshot->m_arena_.create<ccl_data>();
+        copy->m_arena_ = &snapshot->m_arena_;
+        copy->m_type_ = node->m_type_;
+        copy->m_value_ = node->m_value_;
+        copy->store(copy->m_id_, node->m_id_.view());
+        copy->share(copy->m_comment_, node->m_comment_.view());
+        if (node->m_type_ == ccl_type_int_array || node->m_type_ == ccl_type_float_array)
+            copy->store_array(node->m_type_, node->m_string_.view().data(), node->m_string_.view().length());
+        else
+            copy->share(copy->m_string_, node->m_string_.view());
+
+        if (last)
+            last->m_next_ = copy;
+        else
+            snapshot->m_first_node_ = copy;
+        last = copy;
+        snapshot->m_index_.insert(copy);
+    }
+
+    const auto old = m_snapshot_.exchange(snapshot, std::memory_order_seq_cst);
+    if (old)
+        m_retired_snapshots_.push_back(old);
+    reclaim_snapshots(false);
+}
+
+ccl_snapshot_ref ccl_config::snapshot() const
+{
+    return ccl_snapshot_ref(m_snapshot_);
+}
+
+void ccl_config::reclaim_snapshots(const bool wait)
+{
+    while (!m_retired_snapshots_.empty())
+    {
+        std::vector<const ccl_snapshot*> in_use;
+        for (auto block = hazard_blocks.load(std::memory_order_seq_cst); block; block = block->next)
+        {
+            for (auto& slot : block->slots)
+            {
+                const auto s = slot.snapshot.load(std::memory_order_seq_cst);
+                if (s)
+                    in_use.push_back(s);
+            }
+        }
+
+        auto kept = m_retired_snapshots_.begin();
+        for (const auto s : m_retired_snapshots_)
+        {
+            if (std::find(in_use.begin(), in_use.end(), s) == in_use.end())
+                delete s;
+            else
+                *kept++ = s;
+        }
+        m_retired_snapshots_.erase(kept, m_retired_snapshots_.end());
+
+        if (!wait)
+            break;
+        std::this_thread::yield();
+    }
+}
+
+/* Modification time and size of a file */
+static bool file_stamp(const ccl_path& path, int64_t& time, uint64_t& size)
+{
+#ifdef _WIN32
+    struct _stat64 st = {};
+    if (_wstat64(path.c_str(), &st) != 0)
+        return false;
+    time = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#else
+    struct stat st = {};
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#ifdef __APPLE__
+    time = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    time = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+void ccl_config::set_source(ccl_buffer* buffer)
+{
+    m_source_ = buffer;
+    m_source_outdated_ = false;
+    if (!file_stamp(m_path_, m_source_time_, m_source_size_))
+    {
+        m_source_time_ = 0;
+        m_source_size_ = 0;
+    }
+}
+
+void ccl_config::release_buffers()
+{
+    const auto loaded = [this](const ccl_str& str)
+    {
+        const auto data = str.view().data();
+        for (const auto& buffer : m_buffers_)
+        {
+            if (data >= buffer->data() && data < buffer->data() + buffer->size())
+                return true;
+        }
+        return false;
+    };
+
+    if (m_buffers_.empty())
+        return;
+
+    for (auto node = m_first_node_; node; node = node->m_next_)
+    {
+        for (const auto str : { &node->m_id_, &node->m_comment_, &node->m_string_ })
+        {
+            if (str->referenced() && !str->empty() && loaded(*str))
+                node->store(*str, str->view());
+        }
+    }
+    m_buffers_.clear();
+    m_source_ = nullptr;
+}
+
+bool ccl_config::watch(const bool enable)
+{
+    if (enable == m_watching_)
+        return true;
+
+#ifdef __linux__
+    if (m_watch_fd_ != -1)
+    {
+        ::close(m_watch_fd_);
+        m_watch_fd_ = -1;
+    }
+
+    if (enable)
+    {
+        /* Watch the directory, since files are usually replaced
+           instead of written to, which would end a watch on the file */
+        const auto slash = m_path_.find_last_of('/');
+        const auto dir = slash == std::string::npos ? std::string(".")
+            : m_path_.substr(0, slash + 1);
+        m_watch_name_ = slash == std::string::npos ? m_path_ : m_path_.substr(slash + 1);
+
+        m_watch_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_watch_fd_ != -1 && inotify_add_watch(m_watch_fd_, dir.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) == -1)
+        {
+            ::close(m_watch_fd_);
+            m_watch_fd_ = -1;
+        }
+
+        if (m_watch_fd_ == -1)
+        {
+            add_error(ccl_error_watch, ccl_error_normal);
+            return false;
+        }
+    }
+#endif
+    /* The text of the last load doesn't match what was written since.
+       Like m_written_, this copy isn't referenced by any node */
+    if (enable && m_source_outdated_)
+    {
+        std::unique_ptr<ccl_buffer> buffer(new ccl_buffer());
+        if (buffer->open(m_path_, false))
+        {
+            m_written_ = std::move(buffer);
+            set_source(m_written_.get());
+        }
+    }
+    m_watching_ = enable;
+    return true;
+}
+
+bool ccl_config::poll_changes()
+{
+    if (!m_watching_)
+        return false;
+
+#ifdef __linux__
+    /* Only look at the file if there was an event for it */
+    alignas(inotify_event) char events[4096];
+    auto changed = false;
+    ssize_t length;
+
+    while ((length = read(m_watch_fd_, events, sizeof(events))) > 0)
+    {
+        for (auto pos = events; pos < events + length;)
+        {
+            const auto event = reinterpret_cast<const inotify_event*>(pos);
+            if (event->len > 0 && m_watch_name_ == event->name)
+                changed = true;
+            pos += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    if (!changed)
+        return false;
+#endif
+
+    /* Skip changes that were made by this config */
+    int64_t time = 0;
+    uint64_t size = 0;
+    if (!file_stamp(m_path_, time, size)
+        || (m_source_ && time == m_source_time_ && size == m_source_size_))
+        return false;
+
+    const auto result = reload_changes();
+    if (result)
+        check_schema();
+    if (result && m_snapshot_.load(std::memory_order_relaxed))
+        publish();
+    return result;
+}
+
+bool ccl_config::reload_changes()
+{
+    std::unique_ptr<ccl_buffer> buffer(new ccl_buffer());
+    if (!buffer->open(m_path_, (m_flags_ & ccl_load_mapped) != 0))
+        return false;
+    CCL_COUNT(bytes_read, buffer->size());
+
+    const auto old_text = m_source_ ? m_source_->data() : "";
+    const auto old_size = m_source_ ? m_source_->size() : 0;
+    const auto text = buffer->data() ? buffer->data() : "";
+    const auto size = buffer->size();
+
+    /* Find the part of the file that changed */
+    const auto shorter = std::min(old_size, size);
+    size_t prefix = 0, suffix = 0;
+    while (prefix < shorter && old_text[prefix] == text[prefix])
+        prefix++;
+    while (suffix < shorter - prefix
+        && old_text[old_size - suffix - 1] == text[size - suffix - 1])
+        suffix++;
+
+    if (prefix == old_size && prefix == size)
+    {
+        set_source(m_source_);
+        return false;
+    }
+
+    /* Extend it to whole lines in the unchanged parts, including
+       comments in front of the first and after the last changed line */
+    auto begin = prefix;
+    while (begin > 0 && text[begin - 1] != '\n')
+        begin--;
+    while (begin > 0 && text[previous_line(text, begin)] == '#')
+        begin = previous_line(text, begin);
+
+    auto end = size - suffix;
+    while (end < size && text[end] != '\n')
+        end++;
+    end = std::min(end + 1, size);
+
+    for (;;)
+    {
+        const auto old_end = old_size - (size - end);
+        const auto comment = (end > begin && text[previous_line(text, end)] == '#')
+            || (old_end > begin && old_text[previous_line(old_text, old_end)] == '#');
+        if (!comment || end >= size)
+            break;
+        /* Take in the next line, which is the same in both */
+        while (end < size && text[end] != '\n')
+            end++;
+        end = std::min(end + 1, size);
+    }
+    const auto old_end = old_size - (size - end);
+    const auto line = static_cast<int>(std::count(text, text + begin, '\n')) + 1;
+
+    /* Entries in the old part, which are removed unless they still exist */
+    std::unordered_set<std::string_view> removed;
+    ccl_parser::tokenize(old_text + begin, old_text + old_end, line, nullptr,
+        CCL_IGNORE_ERRORS, [&](const ccl_entry& e) { removed.insert(e.id); });
+
+    std::string_view header;
+    uint64_t entries = 0;
+    m_loading_ = true;
+    ccl_parser::tokenize(text + begin, text + end, line, begin == 0 ? &header : nullptr,
+        CCL_REPORT_ERRORS, [&](const ccl_entry& e)
+    {
+        auto node = m_index_.find(e.id);
+        entries++;
+
+        if (node && removed.erase(e.id) > 0)
+        {
+            /* Existing node, only update it if it changed */
+            ccl_data value;
+            value.m_arena_ = node->m_arena_;
+            if (!read_value(&value, e))
+                add_error(ccl_error_invalid_value, ccl_error_normal, e.id, e.line);
+
+            const auto same = value.m_type_ == node->m_type_
+                && value.get_value() == node->get_value()
+                && loaded_comment(e.comment) == node->m_comment_.view();
+            node->reference(node->m_id_, e.id);
+            if (same)
+            {
+                if (node->m_comment_.referenced())
+                    node->m_comment_.reference(loaded_comment(e.comment));
+                if (node->m_string_.referenced())
+                    node->copy_str(node->m_string_, value.m_string_);
+            }
+            else
+            {
+                node->copy_value(value);
+                node->reference(node->m_comment_, loaded_comment(e.comment));
+            }
+            /* value frees its copies, node has its own */
+        }
+        else if (node)
+        {
+            add_error(ccl_error_exists, ccl_error_normal, e.id, e.line);
+        }
+        else
+        {
+            node = m_arena_.create<ccl_data>();
+            node->m_arena_ = &m_arena_;
+            node->m_id_.reference(e.id);
+            node->m_comment_.reference(loaded_comment(e.comment));
+            if (!read_value(node, e))
+                add_error(ccl_error_invalid_value, ccl_error_normal, e.id, e.line);
+            add_node(node);
+        }
+    });
+    m_loading_ = false;
+    CCL_COUNT(entries_parsed, entries);
+
+    for (const auto id : removed)
+    {
+        const auto node = m_index_.find(id);
+        if (node)
+            remove_node(node);
+    }
+
+    if (header.data())
+        m_header_ = std::string(header);
+
+    /* Views into the unchanged parts of the old text are moved over,
+       views into the changed part are copied. After that the old
+       text isn't needed anymore */
+    if (m_source_)
+    {
+        const auto shift = static_cast<ptrdiff_t>(size) - static_cast<ptrdiff_t>(old_size);
+        const auto rebase = [&](ccl_data* node, ccl_str& str)
+        {
+            const auto data = str.view().data();
+            if (str.empty() || data < old_text || data >= old_text + old_size)
+                return;
+
+            const auto offset = static_cast<size_t>(data - old_text);
+            if (offset < begin)
+                str.reference({ text + offset, str.view().length() });
+            else if (offset >= old_end)
+                str.reference({ text + offset + shift, str.view().length() });
+            else
+                node->store(str, str.view());
+        };
+
+        for (auto node = m_first_node_; node; node = node->m_next_)
+        {
+            rebase(node, node->m_id_);
+            rebase(node, node->m_comment_);
+            rebase(node, node->m_string_);
+        }
+
+        for (auto it = m_buffers_.begin(); it != m_buffers_.end(); ++it)
+        {
+            if (it->get() == m_source_)
+            {
+                m_buffers_.erase(it);
+                break;
+            }
+        }
+    }
+
+    set_source(buffer.get());
+    m_buffers_.push_back(std::move(buffer));
+    m_written_.reset();
+    return true;
+}
+
+void ccl_config::compact()
+{
+    write(true);
+}
+
+void ccl_config::set_journal_limit(const size_t bytes)
+{
+    m_journal_limit_ = bytes;
+}
+
+/* Layout of binary cache files, in native byte order
+   Header, nodes in list order, index slots, string table */
+namespace cclb
+{
+    const uint32_t version = 2;
+
+    /* Load flags that change what is stored */
+    const unsigned content_flags = ccl_load_no_comments;
+
+    struct header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t source_hash;
+        int64_t source_time;
+        uint64_t source_size;
+        uint32_t nodes;
+        uint32_t slots;
+        uint32_t header_offset;
+        uint32_t header_length;
+        /* content_flags the cache was written with */
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t strings_size;
+    };
+
+    struct node
+    {
+        uint32_t id_offset, id_length;
+        uint32_t string_offset, string_length;
+        uint32_t comment_offset, comment_length;
+        uint32_t type;
+        /* ccl_data::raw_state, the string of unresolved values is their text */
+        uint32_t raw;
+        /* Raw copy of the parsed value */
+        char value[16];
+    };
+
+    struct slot
+    {
+        uint64_t hash;
+        /* Index of the node plus one, zero for empty slots */
+        uint64_t node;
+    };
+}
+
+/* Hash of file contents, only used to detect changes */
+static uint64_t hash_contents(const char* data, size_t size)
+{
+    uint64_t h = 14695981039346656037ull ^ size;
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        h = (h ^ word) * 1099511628211ull;
+        h ^= h >> 32;
+    }
+    for (; size > 0; data++, size--)
+        h = (h ^ static_cast<unsigned char>(*data)) * 1099511628211ull;
+    return h;
+}
+
+ccl_path ccl_config::cache_path() const
+{
+#ifdef _MSC_VER
+    return m_path_ + L".cclb";
+#else
+    return m_path_ + ".cclb";
+#endif
+}
+
+bool ccl_config::load_cache(const ccl_buffer& text)
+{
+    static_assert(sizeof(ccl_data::value) <= sizeof(cclb::node::value),
+        "Values don't fit into cache nodes");
+
+    std::unique_ptr<ccl_buffer> buffer(new ccl_buffer());
+    if (!buffer->open(cache_path(), true) || buffer->size() < sizeof(cclb::header))
+        return false;
+
+    const auto data = buffer->data();
+    const auto size = buffer->size();
+    const auto h = reinterpret_cast<const cclb::header*>(data);
+    int64_t time = 0;
+    uint64_t file_size = 0;
+
+    if (memcmp(h->magic, "CCLB", 4) != 0 || h->version != cclb::version
+        || !file_stamp(m_path_, time, file_size) || h->source_time != time
+        || h->source_size != file_size || h->source_size != text.size()
+        || h->flags != (m_flags_ & cclb::content_flags)
+        || h->slots & (h->slots - 1) || (h->nodes > 0 && h->slots <= h->nodes))
+        return false;
+
+    const auto nodes_offset = sizeof(cclb::header);
+    const auto slots_offset = nodes_offset + uint64_t(h->nodes) * sizeof(cclb::node);
+    const auto strings_offset = slots_offset + uint64_t(h->slots) * sizeof(cclb::slot);
+    if (strings_offset + h->strings_size != size
+        || uint64_t(h->header_offset) + h->header_length > h->strings_size)
+        return false;
+
+    /* Hashing is still a lot faster than parsing */
+    if (h->source_hash != hash_contents(text.data(), text.size()))
+        return false;
+
+    const auto records = reinterpret_cast<const cclb::node*>(data + nodes_offset);
+    const auto slots = reinterpret_cast<const cclb::slot*>(data + slots_offset);
+    const auto strings = data + strings_offset;
+    const auto in_strings = [&](const uint32_t offset, const uint32_t length)
+    {
+        return uint64_t(offset) + length <= h->strings_size;
+    };
+
+    for (uint32_t i = 0; i < h->nodes; i++)
+    {
+        const auto& r = records[i];
+        if (!in_strings(r.id_offset, r.id_length) || !in_strings(r.string_offset, r.string_length)
+            || !in_strings(r.comment_offset, r.comment_length) || r.type > ccl_type_float_array
+            || r.raw > ccl_data::raw_escaped
+            || (r.type >= ccl_type_int_array && !r.raw && r.string_length % sizeof(int) != 0))
+            return false;
+    }
+    for (uint32_t i = 0; i < h->slots; i++)
+    {
+        if (slots[i].node > h->nodes)
+            return false;
+    }
+
+    std::vector<ccl_data*> nodes(h->nodes);
+    ccl_data* prev = nullptr;
+    for (uint32_t i = 0; i < h->nodes; i++)
+    {
+        const auto& r = records[i];
+        const auto node = m_arena_.create<ccl_data>();
+        node->m_arena_ = &m_arena_;
+        node->m_type_ = static_cast<data_type>(r.type);
+        node->m_raw_ = static_cast<ccl_data::raw_state>(r.raw);
+        node->m_id_.reference({ strings + r.id_offset, r.id_length });
+        node->m_string_.reference({ strings + r.string_offset, r.string_length });
+        /* Array elements are padded to be aligned, but copy them if the
+           mapping isn't */
+        if (node->m_type_ >= ccl_type_int_array && !node->m_raw_
+            && reinterpret_cast<uintptr_t>(strings + r.string_offset) % alignof(int) != 0)
+            node->store_array(node->m_type_, strings + r.string_offset, r.string_length);
+        node->m_comment_.reference(loaded_comment({ strings + r.comment_offset, r.comment_length }));
+        memcpy(&node->m_value_, r.value, sizeof(node->m_value_));
+
+        node->m_prev_ = prev;
+        if (prev)
+            prev->m_next_ = node;
+        else
+            m_first_node_ = node;
+        prev = node;
+        nodes[i] = node;
+    }
+
+    /* The index is taken over as is, nothing has to be hashed */
+    m_index_.m_slots_.assign(h->slots, {});
+    for (uint32_t i = 0; i < h->slots; i++)
+    {
+        if (slots[i].node)
+            m_index_.m_slots_[i] = { slots[i].hash, nodes[slots[i].node - 1] };
+    }
+    m_index_.m_size_ = h->nodes;
+    m_revision_++;
+    CCL_COUNT(bytes_read, size);
+
+    if (h->header_length > 0)
+        m_header_.assign(strings + h->header_offset, h->header_length);
+    m_buffers_.push_back(std::move(buffer));
+    return true;
+}
+
+void ccl_config::write_cache(const ccl_buffer& text)
+{
+    cclb::header h = {};
+    memcpy(h.magic, "CCLB", 4);
+    h.version = cclb::version;
+    h.flags = m_flags_ & cclb::content_flags;
+    h.source_hash = hash_contents(text.data(), text.size());
+    if (!file_stamp(m_path_, h.source_time, h.source_size) || h.source_size != text.size())
+        return;
+
+    std::vector<cclb::node> records;
+    std::string strings;
+    std::unordered_map<const ccl_data*, uint64_t> positions;
+    const auto add_string = [&](const ccl_str& str, uint32_t& offset, uint32_t& length)
+    {
+        offset = static_cast<uint32_t>(strings.length());
+        length = static_cast<uint32_t>(str.view().length());
+        strings.append(str.view());
+    };
+
+    /* Values of lazy loading are stored as text, so
+       they're only parsed when they're used */
+    for (auto node = m_first_node_; node; node = node->m_next_)
+    {
+        cclb::node r = {};
+        add_string(node->m_id_, r.id_offset, r.id_length);
+        if (node->m_type_ >= ccl_type_int_array && !node->m_raw_)
+            strings.resize((strings.length() + alignof(int) - 1) & ~(alignof(int) - 1));
+        add_string(node->m_string_, r.string_offset, r.string_length);
+        add_string(node->m_comment_, r.comment_offset, r.comment_length);
+        r.type = node->m_type_;
+        r.raw = node->m_raw_;
+        memcpy(r.value, &node->m_value_, sizeof(node->m_value_));
+        records.push_back(r);
+        positions[node] = records.size();
+    }
+    h.header_offset = static_cast<uint32_t>(strings.length());
+    h.header_length = static_cast<uint32_t>(m_header_.length());
+    strings.append(m_header_);
+
+    /* Offsets are 32 bit */
+    if (strings.length() > UINT32_MAX)
+        return;
+
+    h.nodes = static_cast<uint32_t>(records.size());
+    h.slots = static_cast<uint32_t>(m_index_.m_slots_.size());
+    h.strings_size = strings.length();
+
+    std::string out;
+    out.reserve(sizeof(h) + records.size() * sizeof(cclb::node)
+        + h.slots * sizeof(cclb::slot) + strings.length());
+    out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(cclb::node));
+    for (const auto& slot : m_index_.m_slots_)
+    {
+        const cclb::slot s = { slot.hash, slot.node ? positions[slot.node] : 0 };
+        out.append(reinterpret_cast<const char*>(&s), sizeof(s));
+    }
+    out.append(strings);
+
+    /* Not being able to cache isn't an error */
+    if (replace_file(cache_path(), out.data(), out.length()))
+        CCL_COUNT(bytes_written, out.length());
+}
+
+ccl_path ccl_config::journal_path() const
+{
+#ifdef _MSC_VER
+    return m_path_ + L".journal";
+#else
+    return m_path_ + ".journal";
+#endif
+}
+
+void ccl_config::replay_journal()
+{
+    std::unique_ptr<ccl_buffer> buffer(new ccl_buffer());
+
+    if (m_path_.empty() || !buffer->open(journal_path(), false))
+        return;
+
+    /* A record without line break was cut off while appending */
+    const auto begin = buffer->data();
+    auto end = begin + buffer->size();
+    while (end > begin && end[-1] != '\n')
+        end--;
+
+    CCL_COUNT(bytes_read, buffer->size());
+    m_loading_ = true;
+    parse(begin, end, true);
+    m_loading_ = false;
+
+    m_journal_size_ = end - begin;
+    if (end != begin + buffer->size())
+        replace_file(journal_path(), begin, m_journal_size_);
+    m_buffers_.push_back(std::move(buffer));
+}
+
+void ccl_config::journal(const ccl_data* node, const bool comment)
+{
+    if (m_loading_ || !(m_flags_ & ccl_load_journal) || m_path_.empty())
+        return;
+
+    if (!m_journal_)
+    {
+#ifdef _MSC_VER
+        m_journal_ = _wfopen(journal_path().c_str(), L"ab");
+#else
+        m_journal_ = fopen(journal_path().c_str(), "ab");
+#endif
+        if (!m_journal_)
+        {
+            add_error(ccl_error_journal_open, ccl_error_normal);
+            return;
+        }
+    }
+
+    auto& record = m_journal_buffer_;
+    record.clear();
+    if (comment)
+    {
+        record.append("# ");
+        record.append(node->m_comment_.view());
+        record.push_back('\n');
+    }
+    record.push_back(static_cast<char>('0' + node->m_type_));
+    record.push_back('_');
+    record.append(node->m_id_.view());
+    record.push_back('=');
+    node->append_value(record, true);
+    record.push_back('\n');
+
+    /* One write per record, which isn't synced to disk */
+    if (fwrite(record.data(), 1, record.length(), m_journal_) != record.length()
+        || fflush(m_journal_) != 0)
+    {
+        add_error(ccl_error_journal_append, ccl_error_normal);
+        return;
+    }
+    CCL_COUNT(bytes_written, record.length());
+
+    m_journal_size_ += record.length();
+    if (m_journal_limit_ > 0 && m_journal_size_ > m_journal_limit_)
+        compact();
+}
+
+void ccl_config::clear_journal()
+{
+    if (m_journal_)
+    {
+        fclose(m_journal_);
+        m_journal_ = nullptr;
+    }
+#ifdef _MSC_VER
+    DeleteFileW(journal_path().c_str());
+#else
+    std::remove(journal_path().c_str());
+#endif
+    m_journal_size_ = 0;
+}
+
+bool ccl_config::is_empty() const
+{
+    return m_empty_;
+}
+
+bool ccl_config::can_write() const
+{
+    auto result = false;
+#ifdef _WIN32
+    if (_waccess(m_path_.c_str(), F_OK) == -1)
+    {
+        /* Create file first */
+		std::ofstream stream;
+		stream.open(m_path_.c_str());
+		stream << "";
+		stream.close();
+    }
+
+    result = _waccess(m_path_.c_str(), W_OK) == 0;
+#else
+    if (access(m_path_.c_str(), F_OK) == -1)
+    {
+		/* Create file first */
+		std::ofstream stream;
 		stream.open(m_path_.c_str());
 		stream << "";
 		stream.close();
     }
 
-	int code = access(m_path_.c_str(), W_OK);
-	result = code != EACCES && code != ENOENT && code != EROFS;
-#endif
-    return result;
+	int code = access(m_path_.c_str(), W_OK);
+	result = code != EACCES && code != ENOENT && code != EROFS;
+#endif
+    return result;
+}
+
+bool ccl_config::can_load() const
+{
+    auto result = false;
+
+#ifdef _WIN32
+    result = _waccess(m_path_.c_str(), R_OK) == 0;
+#else
+	int code = access(m_path_.c_str(), R_OK);
+	result = code != EACCES && code != ENOENT;
+#endif
+    return result;
+}
+
+bool ccl_config::node_exists(const std::string_view id)
+{
+    return get_node(id, true) != nullptr;
+}
+
+ccl_data* ccl_config::get_first() const
+{
+    return m_first_node_;
+}
+
+ccl_data* ccl_config::get_node(const std::string_view id, const bool silent)
+{
+    CCL_COUNT(lookups, 1);
+
+    if (m_empty_)
+    {
+        CCL_COUNT(lookup_misses, 1);
+        return nullptr;
+    }
+
+    const auto node = m_index_.find(id);
+
+    if (node)
+    {
+        /* Values of lazily loaded nodes are only checked now. Silent
+           lookups leave that to the next one, since failed values
+           become zero */
+        if (!silent && !node->resolve())
+            add_error(ccl_error_invalid_value, ccl_error_normal, id);
+        return node;
+    }
+
+    CCL_COUNT(lookup_misses, 1);
+    if (!silent)
+        add_error(ccl_error_not_found, ccl_error_normal, id);
+    return nullptr;
+}
+
+ccl_data* ccl_config::get_typed_node(const std::string_view id, const data_type type,
+    const bool silent)
+{
+    const auto node = get_node(id, silent);
+
+    if (node && node->m_type_ == type)
+    {
+        CCL_COUNT(get_hits[type], 1);
+        return node;
+    }
+
+    if (node)
+        CCL_COUNT(type_mismatches, 1);
+    CCL_COUNT(get_misses[type], 1);
+    if (!silent)
+        add_error(ccl_error_get, ccl_error_normal, id, 0, type);
+    return nullptr;
+}
+
+void ccl_config::add_node(ccl_data* node, const bool replace)
+{
+    if (node)
+    {
+        const auto existing = m_index_.find(node->m_id_.view());
+
+        if (existing)
+        {
+            if (replace)
+            {
+                if (node->get_type() != ccl_type_invalid)
+                {
+                    existing->copy_value(*node);
+                    existing->copy_str(existing->m_comment_, node->m_comment_);
+                    journal(existing, true);
+                }
+                else
+                {
+                    add_error(ccl_error_replace_type, ccl_error_normal,
+                        node->m_id_.view(), 0, node->m_type_);
+                }
+            }
+            else
+            {
+                add_error(ccl_error_exists, ccl_error_normal, node->m_id_.view());
+            }
+
+            /* Existing node keeps its place in the list and index */
+            destroy_node(node);
+            return;
+        }
+
+        if (!node->m_arena_)
+            m_heap_nodes_++;
+        m_empty_ = false;
+        node->m_prev_ = nullptr;
+        node->set_next(m_first_node_);
+        if (m_first_node_)
+            m_first_node_->m_prev_ = node;
+        m_first_node_ = node;
+        m_index_.insert(node);
+        sort_in(node);
+        journal(node, true);
+    }
+}
+
+ccl_data* ccl_config::create_node(const std::string_view id,
+    const std::string_view comment)
+{
+    const auto node = m_arena_.create<ccl_data>();
+    node->m_arena_ = &m_arena_;
+    node->store(node->m_id_, id);
+    node->share(node->m_comment_, comment);
+    return node;
+}
+
+void ccl_config::destroy_node(ccl_data* node)
+{
+    /* Arena nodes give their memory back for new ones */
+    if (node->m_arena_)
+        node->m_arena_->destroy(node);
+    else
+        delete node;
+}
+
+void ccl_config::remove_node(ccl_data* node)
+{
+    m_index_.erase(node);
+    sort_out(node);
+
+    if (node->m_prev_)
+        node->m_prev_->m_next_ = node->m_next_;
+    else
+        m_first_node_ = node->m_next_;
+    if (node->m_next_)
+        node->m_next_->m_prev_ = node->m_prev_;
+
+    if (!node->m_arena_)
+        m_heap_nodes_--;
+    if (!m_first_node_)
+        m_empty_ = true;
+    m_generation_++;
+    destroy_node(node);
+}
+
+static bool id_less(const ccl_data* node, const std::string_view id)
+{
+    return node->get_id_view() < id;
+}
+
+void ccl_config::sort_in(ccl_data* node)
+{
+    const auto sorted = m_sorted_revision_ == m_revision_;
+    m_revision_++;
+    if (sorted)
+    {
+        m_sorted_.insert(std::lower_bound(m_sorted_.begin(), m_sorted_.end(),
+            node->m_id_.view(), id_less), node);
+        m_sorted_revision_ = m_revision_;
+    }
+}
+
+void ccl_config::sort_out(ccl_data* node)
+{
+    const auto sorted = m_sorted_revision_ == m_revision_;
+    m_revision_++;
+    if (sorted)
+    {
+        /* Identifiers are unique, so it's the first one that isn't less */
+        m_sorted_.erase(std::lower_bound(m_sorted_.begin(), m_sorted_.end(),
+            node->m_id_.view(), id_less));
+        m_sorted_revision_ = m_revision_;
+    }
+}
+
+std::pair<size_t, size_t> ccl_config::prefix_range(const std::string_view prefix)
+{
+    if (m_sorted_revision_ != m_revision_)
+    {
+        m_sorted_.clear();
+        m_sorted_.reserve(m_index_.size());
+        for (auto node = m_first_node_; node; node = node->m_next_)
+            m_sorted_.push_back(node);
+        std::sort(m_sorted_.begin(), m_sorted_.end(), [](const ccl_data* a, const ccl_data* b)
+            { return a->m_id_.view() < b->m_id_.view(); });
+        m_sorted_revision_ = m_revision_;
+    }
+
+    /* Identifiers with the prefix are next to each other */
+    const auto first = std::lower_bound(m_sorted_.begin(), m_sorted_.end(), prefix, id_less);
+    const auto last = std::partition_point(first, m_sorted_.end(), [prefix](const ccl_data* node)
+        { return node->m_id_.view().substr(0, prefix.length()) == prefix; });
+    return { static_cast<size_t>(first - m_sorted_.begin()),
+        static_cast<size_t>(last - m_sorted_.begin()) };
+}
+
+ccl_node_range ccl_config::get_prefix(const std::string_view prefix)
+{
+    const auto range = prefix_range(prefix);
+    return { m_sorted_.data() + range.first, m_sorted_.data() + range.second };
+}
+
+size_t ccl_config::count_prefix(const std::string_view prefix)
+{
+    const auto range = prefix_range(prefix);
+    return range.second - range.first;
+}
+
+size_t ccl_config::remove_prefix(const std::string_view prefix)
+{
+    const auto range = prefix_range(prefix);
+    const auto count = range.second - range.first;
+    if (count == 0)
+        return 0;
+
+    /* Erased all at once instead of by remove_node() */
+    m_sorted_revision_ = 0;
+    for (auto i = range.first; i < range.second; i++)
+        remove_node(m_sorted_[i]);
+
+    m_sorted_.erase(m_sorted_.begin() + range.first, m_sorted_.begin() + range.second);
+    m_sorted_revision_ = m_revision_;
+
+    if ((m_flags_ & ccl_load_journal) && !m_loading_)
+        compact();
+    return count;
+}
+
+ccl_section ccl_config::section(const std::string_view name)
+{
+    return ccl_section(this, name);
+}
+
+ccl_section::ccl_section(ccl_config* config, const std::string_view name)
+    : m_config_(config), m_prefix_length_(name.length() + 1)
+{
+    m_key_.reserve(m_prefix_length_ + 32);
+    m_key_.append(name);
+    m_key_.push_back('.');
+}
+
+ccl_section ccl_section::section(const std::string_view sub) const
+{
+    auto name = std::string(m_key_.data(), m_prefix_length_);
+    name.append(sub);
+    return ccl_section(m_config_, name);
+}
+
+std::string_view ccl_section::get_prefix() const
+{
+    return { m_key_.data(), m_prefix_length_ };
+}
+
+std::string_view ccl_section::key(const std::string_view id)
+{
+    m_key_.resize(m_prefix_length_);
+    m_key_.append(id);
+    return m_key_;
+}
+
+ccl_node_range ccl_section::entries()
+{
+    return m_config_->get_prefix(get_prefix());
+}
+
+size_t ccl_section::count()
+{
+    return m_config_->count_prefix(get_prefix());
+}
+
+size_t ccl_section::remove()
+{
+    return m_config_->remove_prefix(get_prefix());
+}
+
+bool ccl_section::node_exists(const std::string_view id)
+{
+    return m_config_->node_exists(key(id));
+}
+
+ccl_data* ccl_section::get_node(const std::string_view id, const bool silent)
+{
+    return m_config_->get_node(key(id), silent);
+}
+
+int ccl_section::get_int(const std::string_view id, const bool silent)
+{
+    return m_config_->get_int(key(id), silent);
+}
+
+float ccl_section::get_float(const std::string_view id, const bool silent)
+{
+    return m_config_->get_float(key(id), silent);
+}
+
+int64_t ccl_section::get_int64(const std::string_view id, const bool silent)
+{
+    return m_config_->get_int64(key(id), silent);
+}
+
+double ccl_section::get_double(const std::string_view id, const bool silent)
+{
+    return m_config_->get_double(key(id), silent);
+}
+
+bool ccl_section::get_bool(const std::string_view id, const bool silent)
+{
+    return m_config_->get_bool(key(id), silent);
+}
+
+std::string ccl_section::get_string(const std::string_view id, const bool silent)
+{
+    return m_config_->get_string(key(id), silent);
+}
+
+std::string_view ccl_section::get_string_view(const std::string_view id, const bool silent)
+{
+    return m_config_->get_string_view(key(id), silent);
+}
+
+ccl_point ccl_section::get_point(const std::string_view id, const bool silent)
+{
+    return m_config_->get_point(key(id), silent);
+}
+
+ccl_rect ccl_section::get_rect(const std::string_view id, const bool silent)
+{
+    return m_config_->get_rect(key(id), silent);
+}
+
+ccl_span<const int> ccl_section::get_int_array(const std::string_view id, const bool silent)
+{
+    return m_config_->get_int_array(key(id), silent);
+}
+
+ccl_span<const float> ccl_section::get_float_array(const std::string_view id, const bool silent)
+{
+    return m_config_->get_float_array(key(id), silent);
+}
+
+void ccl_section::set_int(const std::string_view id, const int val)
+{
+    m_config_->set_int(key(id), val);
+}
+
+void ccl_section::set_float(const std::string_view id, const float val)
+{
+    m_config_->set_float(key(id), val);
+}
+
+void ccl_section::set_int64(const std::string_view id, const int64_t val)
+{
+    m_config_->set_int64(key(id), val);
+}
+
+void ccl_section::set_double(const std::string_view id, const double val)
+{
+    m_config_->set_double(key(id), val);
+}
+
+void ccl_section::set_bool(const std::string_view id, const bool val)
+{
+    m_config_->set_bool(key(id), val);
+}
+
+void ccl_section::set_string(const std::string_view id, const std::string_view val)
+{
+    m_config_->set_string(key(id), val);
+}
+
+void ccl_section::set_point(const std::string_view id, const int x, const int y)
+{
+    m_config_->set_point(key(id), x, y);
+}
+
+void ccl_section::set_rect(const std::string_view id, const int x, const int y,
+    const int w, const int h)
+{
+    m_config_->set_rect(key(id), x, y, w, h);
+}
+
+void ccl_section::set_int_array(const std::string_view id, const ccl_span<const int> values)
+{
+    m_config_->set_int_array(key(id), values);
+}
+
+void ccl_section::set_float_array(const std::string_view id, const ccl_span<const float> values)
+{
+    m_config_->set_float_array(key(id), values);
+}
+
+void ccl_config::set_schema(const ccl_schema_entry* entries, const size_t count)
+{
+    m_schema_.clear();
+    for (size_t i = 0; i < count; i++)
+        m_schema_.push_back(entries + i);
+    std::sort(m_schema_.begin(), m_schema_.end(),
+        [](const ccl_schema_entry* a, const ccl_schema_entry* b) { return a->hash < b->hash; });
+    check_schema();
+}
+
+void ccl_config::check_schema()
+{
+    if (m_schema_.empty())
+        return;
+
+    /* Defaults aren't journaled, they're only written with the config */
+    m_loading_ = true;
+    std::vector<bool> found(m_schema_.size());
+
+    for (auto node = m_first_node_; node; node = node->m_next_)
+    {
+        const auto id = node->m_id_.view();
+        const auto h = ccl_index::hash(id.data(), id.length());
+        auto it = std::lower_bound(m_schema_.begin(), m_schema_.end(), h,
+            [](const ccl_schema_entry* e, const uint64_t v) { return e->hash < v; });
+
+        while (it != m_schema_.end() && (*it)->hash == h && (*it)->id != id)
+            ++it;
+
+        if (it == m_schema_.end() || (*it)->hash != h)
+        {
+            add_error(ccl_error_unknown_key, ccl_error_normal, id);
+            continue;
+        }
+
+        found[it - m_schema_.begin()] = true;
+        if (node->m_type_ != (*it)->type)
+        {
+            add_error(ccl_error_schema_type, ccl_error_normal, id, 0, (*it)->type);
+            (*it)->set_default(node);
+        }
+    }
+
+    for (size_t i = 0; i < m_schema_.size(); i++)
+    {
+        if (found[i])
+            continue;
+        const auto node = create_node(m_schema_[i]->id, {});
+        m_schema_[i]->set_default(node);
+        add_node(node);
+    }
+    m_loading_ = false;
+}
+
+template <class T>
+ccl_handle<T>::ccl_handle(ccl_config* config, std::string id)
+    : m_config_(config), m_id_(std::move(id))
+{
+}
+
+template <class T>
+ccl_data* ccl_handle<T>::node() const
+{
+    if (!m_config_)
+        return nullptr;
+
+    if (!m_node_ || m_generation_ != m_config_->m_generation_)
+    {
+        m_node_ = m_config_->m_empty_ ? nullptr : m_config_->m_index_.find(m_id_);
+        m_generation_ = m_config_->m_generation_;
+    }
+    return m_node_;
+}
+
+template <class T>
+bool ccl_handle<T>::valid() const
+{
+    const auto n = node();
+    return n && n->m_type_ == type;
+}
+
+template <class T>
+T ccl_handle<T>::get() const
+{
+    return valid() && m_node_->resolve() ? m_node_->get_as<T>() : T();
+}
+
+template <class T>
+void ccl_handle<T>::set(const T& val)
+{
+    if (valid())
+    {
+        m_node_->set(val);
+        m_config_->journal(m_node_, false);
+    }
+    else if (m_config_)
+    {
+        m_config_->add_error(ccl_error_set, ccl_error_normal, m_id_, 0, type);
+    }
+}
+
+template class ccl_handle<int>;
+template class ccl_handle<float>;
+template class ccl_handle<int64_t>;
+template class ccl_handle<double>;
+template class ccl_handle<bool>;
+template class ccl_handle<std::string>;
+template class ccl_handle<ccl_point>;
+template class ccl_handle<ccl_rect>;
+template class ccl_handle<std::vector<int>>;
+template class ccl_handle<std::vector<float>>;
+
+ccl_batch_result ccl_config::get_batch(const ccl_binding* bindings, const size_t count,
+    const bool silent)
+{
+    ccl_batch_result result;
+    const ccl_binding* first_failed = nullptr;
+
+    /* Slots are spread over the whole index, so start loading them
+       a few bindings ahead of the lookups */
+    const size_t ahead = 8;
+    for (size_t i = 0; i < std::min(ahead, count); i++)
+        m_index_.prefetch(bindings[i].hash);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i + ahead < count)
+            m_index_.prefetch(bindings[i + ahead].hash);
+
+        const auto& b = bindings[i];
+        const auto node = m_empty_ ? nullptr : m_index_.find(b.id, b.hash);
+
+        if (!node || node->m_type_ != b.type)
+        {
+            if (node)
+                result.mismatched++;
+            else
+                result.missing++;
+            CCL_COUNT(get_misses[b.type], 1);
+            if (!first_failed)
+                first_failed = &b;
+            continue;
+        }
+
+        /* Counted like get_int() and the others, which find the node as well */
+        CCL_COUNT(get_hits[b.type], 1);
+        if (!node->resolve())
+        {
+            if (!silent)
+                add_error(ccl_error_invalid_value, ccl_error_normal, b.id);
+            result.invalid++;
+            if (!first_failed)
+                first_failed = &b;
+            continue;
+        }
+
+        switch (b.type)
+        {
+        case ccl_type_int:
+            *static_cast<int*>(b.target) = node->m_value_.i;
+            break;
+        case ccl_type_float:
+            *static_cast<float*>(b.target) = node->m_value_.f;
+            break;
+        case ccl_type_int64:
+            *static_cast<int64_t*>(b.target) = node->m_value_.l;
+            break;
+        case ccl_type_double:
+            *static_cast<double*>(b.target) = node->m_value_.d;
+            break;
+        case ccl_type_bool:
+            *static_cast<bool*>(b.target) = node->m_value_.b;
+            break;
+        case ccl_type_string:
+            static_cast<std::string*>(b.target)->assign(node->m_string_.view());
+            break;
+        case ccl_type_point:
+            *static_cast<ccl_point*>(b.target) = node->m_value_.point;
+            break;
+        case ccl_type_rect:
+            *static_cast<ccl_rect*>(b.target) = node->m_value_.rect;
+            break;
+        case ccl_type_int_array:
+            {
+                const auto elements = node->array_of<int>();
+                static_cast<std::vector<int>*>(b.target)->assign(elements.begin(), elements.end());
+            }
+            break;
+        case ccl_type_float_array:
+            {
+                const auto elements = node->array_of<float>();
+                static_cast<std::vector<float>*>(b.target)->assign(elements.begin(), elements.end());
+            }
+            break;
+        default:
+            break;
+        }
+        result.done++;
+    }
+
+    CCL_COUNT(lookups, count);
+    CCL_COUNT(lookup_misses, result.missing);
+    CCL_COUNT(type_mismatches, result.mismatched);
+    if (first_failed && !silent)
+        add_error(ccl_error_batch_get, ccl_error_normal, first_failed->id, 0,
+            static_cast<int>(result.missing + result.mismatched + result.invalid));
+    return result;
+}
+
+ccl_batch_result ccl_config::set_batch(const ccl_binding* bindings, const size_t count)
+{
+    ccl_batch_result result;
+    const ccl_binding* first_failed = nullptr;
+
+    /* Slots are spread over the whole index, so start loading them
+       a few bindings ahead of the lookups */
+    const size_t ahead = 8;
+    for (size_t i = 0; i < std::min(ahead, count); i++)
+        m_index_.prefetch(bindings[i].hash);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i + ahead < count)
+            m_index_.prefetch(bindings[i + ahead].hash);
+
+        const auto& b = bindings[i];
+        const auto node = m_empty_ ? nullptr : m_index_.find(b.id, b.hash);
+
+        if (!node || node->m_type_ != b.type)
+        {
+            if (node)
+                result.mismatched++;
+            else
+                result.missing++;
+            if (!first_failed)
+                first_failed = &b;
+            continue;
+        }
+
+        switch (b.type)
+        {
+        case ccl_type_int:
+            node->set_int(*static_cast<const int*>(b.target));
+            break;
+        case ccl_type_float:
+            node->set_float(*static_cast<const float*>(b.target));
+            break;
+        case ccl_type_int64:
+            node->set_int64(*static_cast<const int64_t*>(b.target));
+            break;
+        case ccl_type_double:
+            node->set_double(*static_cast<const double*>(b.target));
+            break;
+        case ccl_type_bool:
+            node->set_bool(*static_cast<const bool*>(b.target));
+            break;
+        case ccl_type_string:
+            node->set_string(*static_cast<const std::string*>(b.target));
+            break;
+        case ccl_type_point:
+            {
+                const auto& p = *static_cast<const ccl_point*>(b.target);
+                node->set_point(p.x, p.y);
+            }
+            break;
+        case ccl_type_rect:
+            {
+                const auto& r = *static_cast<const ccl_rect*>(b.target);
+                node->set_rect(r.x, r.y, r.w, r.h);
+            }
+            break;
+        case ccl_type_int_array:
+            node->set_int_array(*static_cast<const std::vector<int>*>(b.target));
+            break;
+        case ccl_type_float_array:
+            node->set_float_array(*static_cast<const std::vector<float>*>(b.target));
+            break;
+        default:
+            break;
+        }
+        journal(node, false);
+        result.done++;
+    }
+
+    if (first_failed)
+        add_error(ccl_error_batch_set, ccl_error_normal, first_failed->id, 0,
+            static_cast<int>(result.missing + result.mismatched));
+    return result;
+}
+
+void ccl_layered_config::add_layer(ccl_config* config)
+{
+    m_layers_.push_back({ config, 0 });
+    m_write_layer_ = m_layers_.size() - 1;
+}
+
+size_t ccl_layered_config::get_layer_count() const
+{
+    return m_layers_.size();
+}
+
+ccl_config* ccl_layered_config::get_layer(const size_t i) const
+{
+    return i < m_layers_.size() ? m_layers_[i].config : nullptr;
+}
+
+void ccl_layered_config::set_write_layer(const size_t i)
+{
+    if (i < m_layers_.size())
+        m_write_layer_ = i;
+}
+
+size_t ccl_layered_config::get_write_layer() const
+{
+    return m_write_layer_;
+}
+
+bool ccl_layered_config::update()
+{
+    for (const auto& l : m_layers_)
+    {
+        if (l.revision != l.config->m_revision_)
+        {
+            rebuild();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ccl_layered_config::rebuild()
+{
+    size_t count = 0;
+    for (const auto& l : m_layers_)
+        count += l.config->m_index_.size();
+
+    /* Same load factor as ccl_index */
+    size_t size = 16;
+    while (size * 3 < count * 4)
+        size *= 2;
+    m_slots_.assign(size, slot{ 0, nullptr, 0 });
+    const auto mask = size - 1;
+
+    /* Highest layer first, lower layers only add what's missing
+       The hashes are taken over from the index of each layer */
+    for (auto i = m_layers_.size(); i-- > 0;)
+    {
+        auto& l = m_layers_[i];
+        l.revision = l.config->m_revision_;
+
+        for (const auto& from : l.config->m_index_.m_slots_)
+        {
+            if (!from.node)
+                continue;
+
+            const auto id = from.node->m_id_.view();
+            auto j = from.hash & mask;
+            while (m_slots_[j].node && (m_slots_[j].hash != from.hash
+                || m_slots_[j].node->m_id_.view() != id))
+                j = (j + 1) & mask;
+
+            if (!m_slots_[j].node)
+                m_slots_[j] = { from.hash, from.node, i };
+        }
+    }
+}
+
+ccl_layered_config::slot* ccl_layered_config::find(const std::string_view id,
+    const uint64_t hash)
+{
+    if (m_slots_.empty())
+        return nullptr;
+
+    const auto mask = m_slots_.size() - 1;
+    auto i = hash & mask;
+
+    while (m_slots_[i].node)
+    {
+        if (m_slots_[i].hash == hash && m_slots_[i].node->m_id_.view() == id)
+            return &m_slots_[i];
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+ccl_data* ccl_layered_config::get_node(const std::string_view id)
+{
+    update();
+    const auto s = find(id, ccl_index::hash(id.data(), id.length()));
+    if (!s)
+        return nullptr;
+    s->node->resolve();
+    return s->node;
+}
+
+int ccl_layered_config::get_owner(const std::string_view id)
+{
+    update();
+    const auto s = find(id, ccl_index::hash(id.data(), id.length()));
+    return s ? static_cast<int>(s->layer) : -1;
+}
+
+bool ccl_layered_config::node_exists(const std::string_view id)
+{
+    return get_node(id) != nullptr;
+}
+
+template <class T>
+T ccl_layered_config::get_value(const std::string_view id)
+{
+    const auto node = get_node(id);
+    return node && node->m_type_ == ccl_type_of<T>::value ? node->get_as<T>() : T();
+}
+
+int ccl_layered_config::get_int(const std::string_view id)
+{
+    return get_value<int>(id);
+}
+
+float ccl_layered_config::get_float(const std::string_view id)
+{
+    return get_value<float>(id);
+}
+
+int64_t ccl_layered_config::get_int64(const std::string_view id)
+{
+    return get_value<int64_t>(id);
+}
+
+double ccl_layered_config::get_double(const std::string_view id)
+{
+    return get_value<double>(id);
+}
+
+bool ccl_layered_config::get_bool(const std::string_view id)
+{
+    return get_value<bool>(id);
+}
+
+std::string ccl_layered_config::get_string(const std::string_view id)
+{
+    return std::string(get_string_view(id));
+}
+
+std::string_view ccl_layered_config::get_string_view(const std::string_view id)
+{
+    const auto node = get_node(id);
+    return node ? node->get_string() : std::string_view();
+}
+
+ccl_point ccl_layered_config::get_point(const std::string_view id)
+{
+    return get_value<ccl_point>(id);
+}
+
+ccl_rect ccl_layered_config::get_rect(const std::string_view id)
+{
+    return get_value<ccl_rect>(id);
+}
+
+ccl_span<const int> ccl_layered_config::get_int_array(const std::string_view id)
+{
+    const auto node = get_node(id);
+    return node ? node->get_int_array() : ccl_span<const int>();
+}
+
+ccl_span<const float> ccl_layered_config::get_float_array(const std::string_view id)
+{
+    const auto node = get_node(id);
+    return node ? node->get_float_array() : ccl_span<const float>();
+}
+
+template <class F>
+void ccl_layered_config::set_value(const std::string_view id, const data_type type,
+    F&& store)
+{
+    if (m_layers_.empty())
+        return;
+
+    const auto current = update();
+    const auto config = m_layers_[m_write_layer_].config;
+    const auto h = ccl_index::hash(id.data(), id.length());
+    const auto s = find(id, h);
+    const auto own = config->m_index_.find(id, h);
+
+    if (own && own->m_type_ == type)
+    {
+        store(own);
+        config->journal(own, false);
+        return;
+    }
+
+    if (own || !s || s->node->m_type_ != type)
+    {
+        config->add_error(ccl_error_set, ccl_error_normal, id, 0, type);
+        return;
+    }
+
+    const auto node = config->create_node(id, s->node->m_comment_.view());
+    store(node);
+    config->add_node(node);
+
+    /* Only this node was added, so the index doesn't have to be
+       rebuilt. Higher layers still hide it if they have the entry */
+    if (current)
+    {
+        if (s->layer < m_write_layer_)
+        {
+            s->node = node;
+            s->layer = m_write_layer_;
+        }
+        m_layers_[m_write_layer_].revision = config->m_revision_;
+    }
 }
 
-bool ccl_config::can_load() const
+void ccl_layered_config::set_int(const std::string_view id, const int val)
 {
-    auto result = false;
+    set_value(id, ccl_type_int, [val](ccl_data* node) { node->set_int(val); });
+}
 
-#ifdef _WIN32
-    result = _waccess(m_path_.c_str(), R_OK) == 0;
-#else
-	int code = access(m_path_.c_str(), R_OK);
-	result = code != EACCES && code != ENOENT;
-#endif
-    return result;
+void ccl_layered_config::set_float(const std::string_view id, const float val)
+{
+    set_value(id, ccl_type_float, [val](ccl_data* node) { node->set_float(val); });
 }
 
-bool ccl_config::node_exists(const std::string& id)
+void ccl_layered_config::set_int64(const std::string_view id, const int64_t val)
 {
-    return get_node(id, true) != nullptr;
+    set_value(id, ccl_type_int64, [val](ccl_data* node) { node->set_int64(val); });
 }
 
-ccl_data* ccl_config::get_first() const
+void ccl_layered_config::set_double(const std::string_view id, const double val)
 {
-    return m_first_node_;
+    set_value(id, ccl_type_double, [val](ccl_data* node) { node->set_double(val); });
 }
 
-ccl_data* ccl_config::get_node(const std::string& id, const bool silent)
+void ccl_layered_config::set_bool(const std::string_view id, const bool val)
 {
-    if (m_empty_)
-    {
-        return nullptr;
-    }
+    set_value(id, ccl_type_bool, [val](ccl_data* node) { node->set_bool(val); });
+}
 
-    auto node = m_first_node_;
+void ccl_layered_config::set_string(const std::string_view id, const std::string_view val)
+{
+    set_value(id, ccl_type_string, [val](ccl_data* node) { node->set_string(val); });
+}
 
-    while (node)
-    {
-        if (node->get_id() == id)
-        {
-            return node;
-        }
+void ccl_layered_config::set_point(const std::string_view id, const int x, const int y)
+{
+    set_value(id, ccl_type_point, [x, y](ccl_data* node) { node->set_point(x, y); });
+}
 
-        node = node->get_next();
-    }
+void ccl_layered_config::set_rect(const std::string_view id, const int x, const int y,
+    const int w, const int h)
+{
+    set_value(id, ccl_type_rect, [=](ccl_data* node) { node->set_rect(x, y, w, h); });
+}
 
-    if (!silent)
-        add_error(format(
-                "Value with id '%s' does not exist", id.c_str()),
-            ccl_error_normal);
-    return nullptr;
+void ccl_layered_config::set_int_array(const std::string_view id, const ccl_span<const int> values)
+{
+    set_value(id, ccl_type_int_array, [values](ccl_data* node) { node->set_int_array(values); });
 }
 
-void ccl_config::add_node(ccl_data* node, const bool replace)
+void ccl_layered_config::set_float_array(const std::string_view id, const ccl_span<const float> values)
 {
-    if (node)
-    {
-        if (node_exists(node->get_id()))
-        {
-            if (replace)
-            {
-                auto existing = get_node(node->get_id(), replace);
-                if (node->get_type() != ccl_type_invalid)
-                {
-                    existing->set_value(node->get_value(), node->get_type());
-                    existing->set_comment(node->get_comment());
-                }
-                else
-                {
-                    add_error(
-                        format(
-                            "Can't replace node '%s', because \
-replacement has invalid type '%i'",
-                            node->get_id().c_str(), node->get_type()),
-                        ccl_error_normal);
-                }
-            }
-            else
-            {
-                add_error(format(
-                        "Value with id '%s' already exists", node->get_id().c_str()),
-                    ccl_error_normal);
-                return;
-            }
-        }
-        m_empty_ = false;
-        node->set_next(m_first_node_);
-        m_first_node_ = node;
-    }
+    set_value(id, ccl_type_float_array, [values](ccl_data* node) { node->set_float_array(values); });
 }
 
-void ccl_config::add_int(const std::string& id, const std::string& comment,
+void ccl_config::add_int(const std::string_view id, const std::string_view comment,
     const int val, const bool replace)
 {
-    add_node(new ccl_data(id, comment, val), replace);
+    const auto node = create_node(id, comment);
+    node->set_int(val);
+    add_node(node, replace);
 }
 
-void ccl_config::add_float(const std::string& id, const std::string& comment,
+void ccl_config::add_float(const std::string_view id, const std::string_view comment,
     const float val, const bool replace)
 {
-    add_node(new ccl_data(id, comment, val), replace);
+    const auto node = create_node(id, comment);
+    node->set_float(val);
+    add_node(node, replace);
+}
+
+void ccl_config::add_int64(const std::string_view id, const std::string_view comment,
+    const int64_t val, const bool replace)
+{
+    const auto node = create_node(id, comment);
+    node->set_int64(val);
+    add_node(node, replace);
+}
+
+void ccl_config::add_double(const std::string_view id, const std::string_view comment,
+    const double val, const bool replace)
+{
+    const auto node = create_node(id, comment);
+    node->set_double(val);
+    add_node(node, replace);
 }
 
-void ccl_config::add_bool(const std::string& id, const std::string& comment,
+void ccl_config::add_bool(const std::string_view id, const std::string_view comment,
     const bool val, const bool replace)
 {
-    add_node(new ccl_data(id, comment, val), replace);
+    const auto node = create_node(id, comment);
+    node->set_bool(val);
+    add_node(node, replace);
 }
 
-void ccl_config::add_string(const std::string& id, const std::string& comment,
-    const std::string& val, const bool replace)
+void ccl_config::add_string(const std::string_view id, const std::string_view comment,
+    const std::string_view val, const bool replace)
 {
-    add_node(new ccl_data(id, comment, val), replace);
+    const auto node = create_node(id, comment);
+    node->set_string(val);
+    add_node(node, replace);
 }
 
-void ccl_config::add_point(const std::string& id, const std::string& comment,
+void ccl_config::add_point(const std::string_view id, const std::string_view comment,
     const int x, const int y, const bool replace)
 {
-    add_node(new ccl_data(id, comment, x, y), replace);
+    const auto node = create_node(id, comment);
+    node->set_point(x, y);
+    add_node(node, replace);
 }
 
-void ccl_config::add_rect(const std::string& id, const std::string& comment,
+void ccl_config::add_rect(const std::string_view id, const std::string_view comment,
     const int x, const int y, const int w, const int h, const bool replace)
 {
-    add_node(new ccl_data(id, comment, x, y, w, h), replace);
+    const auto node = create_node(id, comment);
+    node->set_rect(x, y, w, h);
+    add_node(node, replace);
+}
+
+void ccl_config::add_int_array(const std::string_view id, const std::string_view comment,
+    const ccl_span<const int> values, const bool replace)
+{
+    const auto node = create_node(id, comment);
+    node->set_int_array(values);
+    add_node(node, replace);
+}
+
+void ccl_config::add_float_array(const std::string_view id, const std::string_view comment,
+    const ccl_span<const float> values, const bool replace)
+{
+    const auto node = create_node(id, comment);
+    node->set_float_array(values);
+    add_node(node, replace);
 }
 
-void ccl_config::set_int(const std::string& id, const int val)
+void ccl_config::set_int(const std::string_view id, const int val)
 {
     auto node = get_node(id);
 
     if (node && node->get_type() == ccl_type_int)
     {
         node->set_int(val);
+        journal(node, false);
     }
     else
     {
-        add_error(format(
-            "Cannot set value of '%s' to '%i'. Doesn't exist or type mismatch",
-            id.c_str(), val), ccl_error_normal);
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_int);
     }
 }
 
-void ccl_config::set_float(const std::string& id, const float val)
+void ccl_config::set_float(const std::string_view id, const float val)
 {
     auto node = get_node(id);
 
     if (node && node->get_type() == ccl_type_float)
     {
         node->set_float(val);
+        journal(node, false);
+    }
+    else
+    {
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_float);
+    }
+}
+
+void ccl_config::set_int64(const std::string_view id, const int64_t val)
+{
+    auto node = get_node(id);
+
+    if (node && node->get_type() == ccl_type_int64)
+    {
+        node->set_int64(val);
+        journal(node, false);
+    }
+    else
+    {
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_int64);
+    }
+}
+
+void ccl_config::set_double(const std::string_view id, const double val)
+{
+    auto node = get_node(id);
+
+    if (node && node->get_type() == ccl_type_double)
+    {
+        node->set_double(val);
+        journal(node, false);
     }
     else
     {
-        add_error(format(
-            "Cannot set value of '%s' to '%f'. Doesn't exist or type mismatch",
-            id.c_str(), val), ccl_error_normal);
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_double);
     }
 }
 
-void ccl_config::set_bool(const std::string& id, const bool val)
+void ccl_config::set_bool(const std::string_view id, const bool val)
 {
     auto node = get_node(id);
 
     if (node && node->get_type() == ccl_type_bool)
     {
         node->set_bool(val);
+        journal(node, false);
     }
     else
     {
-        add_error(format(
-            "Cannot set value of '%s' to '%i'. Doesn't exist or type mismatch",
-            id.c_str(), val), ccl_error_normal);
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_bool);
     }
 }
 
-void ccl_config::set_string(const std::string& id, const std::string& val)
+void ccl_config::set_string(const std::string_view id, const std::string_view val)
 {
     auto node = get_node(id);
 
     if (node && node->get_type() == ccl_type_string)
     {
         node->set_string(val);
+        journal(node, false);
     }
     else
     {
-        add_error(format(
-            "Cannot set value of '%s' to '%s'. Doesn't exist or type mismatch",
-            id.c_str(), val), ccl_error_normal);
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_string);
     }
 }
 
-void ccl_config::set_point(const std::string& id, const int x, const int y)
+void ccl_config::set_point(const std::string_view id, const int x, const int y)
 {
     auto node = get_node(id);
 
     if (node && node->get_type() == ccl_type_point)
     {
         node->set_point(x, y);
+        journal(node, false);
     }
     else
     {
-        add_error(format(
-            "Cannot set value of '%s' to 'X: %i, Y: %i'. Doesn't exist or type mismatch",
-            id.c_str(), x, y), ccl_error_normal);
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_point);
     }
 }
 
-void ccl_config::set_rect(const std::string& id, int x, int y, int w, int h)
+void ccl_config::set_rect(const std::string_view id, int x, int y, int w, int h)
 {
     auto node = get_node(id);
 
     if (node && node->get_type() == ccl_type_rect)
     {
         node->set_rect(x, y, w, h);
+        journal(node, false);
     }
     else
     {
-        add_error(format(
-            "Cannot set value of '%s' to 'X: %i, Y: %i, W: %i, H: %i'. Doesn't exist or type mismatch",
-            id.c_str(), x, y, w, h), ccl_error_normal);
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_rect);
     }
 }
 
-int ccl_config::get_int(const std::string& id, const bool silent)
+void ccl_config::set_int_array(const std::string_view id, const ccl_span<const int> values)
 {
-    const auto node = get_node(id);
+    auto node = get_node(id);
 
-    if (node && node->get_type() == ccl_type_int)
+    if (node && node->get_type() == ccl_type_int_array)
     {
-        return std::stoi(node->get_value());
+        node->set_int_array(values);
+        journal(node, false);
     }
-
-    if (!silent)
-        add_error(format(
-            "Cannot get int value of '%s'. Doesn't exist or type mismatch",
-            id.c_str()), ccl_error_normal);
-
-    return 0;
-}
-
-int ccl_config::get_hex(const std::string& id, const bool silent)
-{
-    const auto node = get_node(id);
-    if (node && node->get_type() == ccl_type_string)
+    else
     {
-        auto value = node->get_value();
-        if (value.find("0x") != std::string::npos)
-        {
-            return std::stoul(value, nullptr, 16);
-        }
-        return static_cast<uint16_t>(0x0);
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_int_array);
     }
-
-    if (!silent)
-        add_error(format(
-            "Cannot get hex value of '%s'. Doesn't exist or type mismatch",
-            id.c_str()), ccl_error_normal);
-
-    return 0x0;
 }
 
-float ccl_config::get_float(const std::string& id, const bool silent)
+void ccl_config::set_float_array(const std::string_view id, const ccl_span<const float> values)
 {
-    const auto node = get_node(id, silent);
+    auto node = get_node(id);
 
-    if (node && node->get_type() == ccl_type_float)
+    if (node && node->get_type() == ccl_type_float_array)
     {
-        return std::stof(node->get_value());
+        node->set_float_array(values);
+        journal(node, false);
     }
+    else
+    {
+        add_error(ccl_error_set, ccl_error_normal, id, 0, ccl_type_float_array);
+    }
+}
 
-    if (!silent)
-        add_error(format(
-            "Cannot get float value of '%s'. Doesn't exist or type mismatch",
-            id.c_str()), ccl_error_normal);
+int ccl_config::get_int(const std::string_view id, const bool silent)
+{
+    const auto node = get_typed_node(id, ccl_type_int, silent);
+    return node ? node->m_value_.i : 0;
+}
 
-    return 0.0f;
+int ccl_config::get_hex(const std::string_view id, const bool silent)
+{
+    const auto node = get_typed_node(id, ccl_type_string, silent);
+    return node ? hex_value(node->m_string_.view()) : 0x0;
 }
 
-bool ccl_config::get_bool(const std::string& id, const bool silent)
+float ccl_config::get_float(const std::string_view id, const bool silent)
 {
-    const auto node = get_node(id);
+    const auto node = get_typed_node(id, ccl_type_float, silent);
+    return node ? node->m_value_.f : 0.0f;
+}
 
-    if (node && node->get_type() == ccl_type_bool)
-    {
-        return std::stoi(node->get_value()) == 1;
-    }
+int64_t ccl_config::get_int64(const std::string_view id, const bool silent)
+{
+    const auto node = get_typed_node(id, ccl_type_int64, silent);
+    return node ? node->m_value_.l : 0;
+}
 
-    if (!silent)
-        add_error(format(
-            "Cannot get bool value of '%s'. Doesn't exist or type mismatch",
-            id.c_str()), ccl_error_normal);
+double ccl_config::get_double(const std::string_view id, const bool silent)
+{
+    const auto node = get_typed_node(id, ccl_type_double, silent);
+    return node ? node->m_value_.d : 0.0;
+}
 
-    return false;
+bool ccl_config::get_bool(const std::string_view id, const bool silent)
+{
+    const auto node = get_typed_node(id, ccl_type_bool, silent);
+    return node ? node->m_value_.b : false;
 }
 
-std::string ccl_config::get_string(const std::string& id, const bool silent)
+std::string ccl_config::get_string(const std::string_view id, const bool silent)
 {
-    const auto node = get_node(id);
+    const auto node = get_node(id, silent);
 
+    /* Values of all types are formatted as text */
     if (node)
     {
+        CCL_COUNT(get_hits[ccl_type_string], 1);
         return node->get_value();
     }
 
+    CCL_COUNT(get_misses[ccl_type_string], 1);
     if (!silent)
-        add_error(format(
-            "Cannot get string value of '%s'. Doesn't exist or type mismatch",
-            id.c_str()), ccl_error_normal);
+        add_error(ccl_error_get, ccl_error_normal, id, 0, ccl_type_string);
 
     return "";
 }
 
-int ccl_config::get_point_x(const std::string& id, const bool silent)
+std::string_view ccl_config::get_string_view(const std::string_view id, const bool silent)
+{
+    const auto node = get_typed_node(id, ccl_type_string, silent);
+    return node ? node->m_string_.view() : std::string_view();
+}
+
+int ccl_config::get_point_x(const std::string_view id, const bool silent)
 {
     return get_point(id, silent).x;
 }
 
-int ccl_config::get_point_y(const std::string& id, const bool silent)
+int ccl_config::get_point_y(const std::string_view id, const bool silent)
 {
     return get_point(id, silent).y;
 }
 
-int ccl_config::get_rect_x(const std::string& id, const bool silent)
+int ccl_config::get_rect_x(const std::string_view id, const bool silent)
 {
     return get_rect(id, silent).x;
 }
 
-int ccl_config::get_rect_y(const std::string& id, const bool silent)
+int ccl_config::get_rect_y(const std::string_view id, const bool silent)
 {
     return get_rect(id, silent).y;
 }
 
-int ccl_config::get_rect_w(const std::string& id, const bool silent)
+int ccl_config::get_rect_w(const std::string_view id, const bool silent)
 {
     return get_rect(id, silent).w;
 }
 
-int ccl_config::get_rect_h(const std::string& id, const bool silent)
+int ccl_config::get_rect_h(const std::string_view id, const bool silent)
 {
     return get_rect(id, silent).h;
 }
 
-ccl_point ccl_config::get_point(const std::string& id, const bool silent)
+ccl_point ccl_config::get_point(const std::string_view id, const bool silent)
 {
-    const auto node = get_node(id, silent);
-    if (node)
-    {
-        std::string segment;
-        std::vector<std::string> segments;
-        std::stringstream stream(node->get_value());
-
-        while (std::getline(stream, segment, ','))
-        {
-            segments.push_back(segment);
-        }
-        ccl_point out = {};
-
-        if (segments.size() > 1)
-        {
-            try
-            {
-                out.x = std::stoi(segments[0]);
-                out.y = std::stoi(segments[1]);
-            }
-            catch (std::invalid_argument& e)
-            {
-                add_error(format(
-                    "Cannot get convert string value of '%s' to int (Exception: %s)",
-                    id.c_str(), e.what()), ccl_error_normal);
-            }
-            catch (std::out_of_range& e)
-            {
-                add_error(format(
-                    "Cannot get fit integer value of '%s'. Exceeds range (Exception: %s)",
-                    id.c_str(), e.what()), ccl_error_normal);
-            }
-            catch (...)
-            {
-                add_error(format(
-                    "Error while converting integer value of '%s'. Unknown exception",
-                    id.c_str()), ccl_error_normal);
-            }
-
-            return out;
-        }
-    }
-    if (!silent)
-        add_error(format(
-            "Cannot get point value of '%s'. Doesn't exist or type mismatch",
-            id.c_str()), ccl_error_normal);
-    return {};
+    const auto node = get_typed_node(id, ccl_type_point, silent);
+    return node ? node->m_value_.point : ccl_point();
 }
 
-ccl_rect ccl_config::get_rect(const std::string& id, const bool silent)
+ccl_rect ccl_config::get_rect(const std::string_view id, const bool silent)
 {
-    const auto node = get_node(id, silent);
-
-    if (node)
-    {
-        std::string segment;
-        std::vector<std::string> segments;
-        std::stringstream stream(node->get_value());
-
-        while (std::getline(stream, segment, ','))
-        {
-            segments.push_back(segment);
-        }
+    const auto node = get_typed_node(id, ccl_type_rect, silent);
+    return node ? node->m_value_.rect : ccl_rect();
+}
 
-        ccl_rect out = {};
-        if (segments.size() > 3)
-        {
-            try
-            {
-                out.x = std::stoi(segments[0]);
-                out.y = std::stoi(segments[1]);
-                out.w = std::stoi(segments[2]);
-                out.h = std::stoi(segments[3]);
-            }
-            catch (std::invalid_argument& e)
-            {
-                add_error(format(
-                    "Cannot get convert string value of '%s' to int (Exception: %s)",
-                    id.c_str(), e.what()), ccl_error_normal);
-            }
-            catch (std::out_of_range& e)
-            {
-                add_error(format(
-                    "Cannot get fit integer value of '%s'. Exceeds range (Exception: %s)",
-                    id.c_str(), e.what()), ccl_error_normal);
-            }
-            catch (...)
-            {
-                add_error(format(
-                    "Error while converting integer value of '%s'. Unknown exception",
-                    id.c_str()), ccl_error_normal);
-            }
+ccl_span<const int> ccl_config::get_int_array(const std::string_view id, const bool silent)
+{
+    const auto node = get_typed_node(id, ccl_type_int_array, silent);
+    return node ? node->array_of<int>() : ccl_span<const int>();
+}
 
-            return out;
-        }
-    }
-    if (!silent)
-        add_error(format(
-            "Cannot get point value of '%s'. Doesn't exist or type mismatch",
-            id.c_str()), ccl_error_normal);
-    return {};
+ccl_span<const float> ccl_config::get_float_array(const std::string_view id, const bool silent)
+{
+    const auto node = get_typed_node(id, ccl_type_float_array, silent);
+    return node ? node->array_of<float>() : ccl_span<const float>();
 }
 
 bool ccl_config::has_errors() const
 {
-    return !m_errors_.empty();
+    return m_error_count_ > 0;
 }
 
 bool ccl_config::has_fatal_errors() const
@@ -910,31 +4658,248 @@ std::string ccl_config::get_error_message()
 	error = format("Encountered errors when loading '%s':",
         m_path_.c_str());
 #endif
-    auto i = 0;
-    auto flag = false;
 
-    for (auto const& e : m_errors_)
+    /* Oldest first */
+    for (auto i = MAX_ERROR_REPORT; i > 0; i--)
     {
-        error.append(format("\n [%s] %s", error_to_string(e.second),
-            e.first.c_str()));
-        if (++i > MAX_ERROR_REPORT)
-        {
-            flag = true;
-            break;
-        }
+        const auto e = get_error(i - 1);
+        if (!e)
+            continue;
+        error.append("\n [");
+        error.append(error_to_string(e->level));
+        error.append("] ");
+        error.append(format_error(*e));
     }
 
-    if (flag)
+    if (m_error_count_ > MAX_ERROR_REPORT)
         error.append(format("\n %i more error(s) reported",
-            m_errors_.size() - MAX_ERROR_REPORT));
+            static_cast<int>(m_error_count_ - MAX_ERROR_REPORT)));
     return error;
 }
 
-void ccl_config::add_error(const std::string& error_msg, const error_level lvl)
+size_t ccl_config::get_error_count() const
 {
-    if (lvl == ccl_error_fatal)
+    return m_error_count_;
+}
+
+const ccl_error* ccl_config::get_error(const size_t i) const
+{
+    if (i >= MAX_ERROR_REPORT || i >= m_error_count_)
+        return nullptr;
+    return &m_errors_[(m_error_count_ - 1 - i) % MAX_ERROR_REPORT];
+}
+
+#ifndef CCL_NO_STATS
+/* Reads or writes one counter of ccl_stats_of */
+static uint64_t stat_value(const std::atomic<uint64_t>& counter)
+{
+    return counter.load(std::memory_order_relaxed);
+}
+
+static uint64_t stat_value(const uint64_t counter)
+{
+    return counter;
+}
+
+static void stat_store(std::atomic<uint64_t>& counter, const uint64_t value)
+{
+    counter.store(value, std::memory_order_relaxed);
+}
+
+static void stat_store(uint64_t& counter, const uint64_t value)
+{
+    counter = value;
+}
+
+template <class To, class From>
+static void copy_stats(To& to, const From& from)
+{
+    stat_store(to.lookups, stat_value(from.lookups));
+    stat_store(to.lookup_misses, stat_value(from.lookup_misses));
+    for (size_t i = 0; i < ccl_stats::type_count; i++)
+    {
+        stat_store(to.get_hits[i], stat_value(from.get_hits[i]));
+        stat_store(to.get_misses[i], stat_value(from.get_misses[i]));
+    }
+    stat_store(to.type_mismatches, stat_value(from.type_mismatches));
+    stat_store(to.entries_parsed, stat_value(from.entries_parsed));
+    stat_store(to.bytes_read, stat_value(from.bytes_read));
+    stat_store(to.bytes_written, stat_value(from.bytes_written));
+    stat_store(to.loads, stat_value(from.loads));
+    stat_store(to.writes, stat_value(from.writes));
+    stat_store(to.load_ns, stat_value(from.load_ns));
+    stat_store(to.write_ns, stat_value(from.write_ns));
+    stat_store(to.allocations, stat_value(from.allocations));
+}
+#endif
+
+ccl_stats ccl_config::get_stats() const
+{
+    ccl_stats stats;
+#ifndef CCL_NO_STATS
+    copy_stats(stats, m_stats_);
+    stats.allocations += m_arena_.blocks_allocated();
+#endif
+    return stats;
+}
+
+void ccl_config::reset_stats()
+{
+#ifndef CCL_NO_STATS
+    copy_stats(m_stats_, ccl_stats());
+    /* Wraps around, get_stats() adds the blocks back */
+    stat_store(m_stats_.allocations, 0 - m_arena_.blocks_allocated());
+#endif
+}
+
+ccl_memory_usage ccl_config::memory_usage() const
+{
+    ccl_memory_usage usage;
+
+    for (const auto& buffer : m_buffers_)
+    {
+        if (buffer->mapped())
+            usage.mapped += buffer->size();
+        else
+            usage.files += buffer->size();
+    }
+    if (m_written_)
+        usage.files += m_written_->size();
+
+    /* Strings in loaded files or the intern table are counted there */
+    const auto copied = [&](const ccl_str& str) -> size_t
+    {
+        const auto view = str.view();
+        if (view.empty() || m_arena_.is_interned(view))
+            return 0;
+        for (const auto& buffer : m_buffers_)
+        {
+            if (view.data() >= buffer->data() && view.data() < buffer->data() + buffer->size())
+                return 0;
+        }
+        return view.length();
+    };
+
+    size_t in_arena = 0;
+    for (auto node = m_first_node_; node; node = node->m_next_)
+    {
+        const auto id = copied(node->m_id_);
+        const auto comment = copied(node->m_comment_);
+        const auto value = copied(node->m_string_);
+        usage.nodes += sizeof(ccl_data);
+        usage.ids += id;
+        usage.comments += comment;
+        usage.values += value;
+        if (node->m_arena_)
+            in_arena += sizeof(ccl_data) + id + comment + value;
+    }
+
+    usage.interned = m_arena_.interned_bytes() + m_arena_.intern_table_bytes();
+    usage.index = m_index_.m_slots_.capacity() * sizeof(m_index_.m_slots_[0])
+        + m_sorted_.capacity() * sizeof(ccl_data*);
+    usage.unused = m_arena_.capacity() - m_arena_.used();
+
+    /* Whatever the arena holds that no entry uses anymore */
+    const auto live = in_arena + m_arena_.interned_bytes();
+    if (m_arena_.used() > live)
+        usage.other = m_arena_.used() - live;
+    usage.other += m_journal_buffer_.capacity() + m_header_.capacity()
+        + m_schema_.capacity() * sizeof(ccl_schema_entry*);
+
+    usage.total = usage.nodes + usage.ids + usage.comments + usage.values + usage.interned
+        + usage.index + usage.files + usage.unused + usage.other;
+    return usage;
+}
+
+void ccl_config::add_error(const error_code code, const error_level lvl,
+    const std::string_view key, const int line, const int detail)
+{
+    add_error(make_error(code, lvl, key, line, detail));
+}
+
+void ccl_config::add_error(const ccl_error& error)
+{
+    if (error.level == ccl_error_fatal)
         m_fatal_errors_ = true;
-    m_errors_[error_msg] = lvl;
+
+    /* Errors repeated in a loop would push out all others */
+    for (size_t i = 0; i < MAX_ERROR_REPORT && i < m_error_count_; i++)
+    {
+        const auto& e = m_errors_[i];
+        if (e.code == error.code && e.line == error.line && e.detail == error.detail
+            && e.get_key() == error.get_key())
+            return;
+    }
+
+    m_errors_[m_error_count_ % MAX_ERROR_REPORT] = error;
+    m_error_count_++;
+}
+
+std::string ccl_config::format_error(const ccl_error& error) const
+{
+    static const char* type_names[] = { "int", "string", "bool", "float", "point", "rect",
+        "int64", "double", "int array", "float array" };
+
+    auto key = std::string(error.get_key());
+    if (error.key_truncated)
+        key.append("...");
+    const auto k = key.c_str();
+    const auto type = error.detail >= 0 && error.detail <= ccl_type_float_array
+        ? type_names[error.detail] : "invalid";
+#ifdef _WIN32
+    const auto path = to_utf8(m_path_);
+#else
+    const auto& path = m_path_;
+#endif
+
+    switch (error.code)
+    {
+    case ccl_error_file_access:
+        return format("File %s does not exist or cannot be accessed", path.c_str());
+    case ccl_error_header:
+        return "Line one in config should be a header comment! First value skipped!";
+    case ccl_error_empty_line:
+        return format("Line %i was empty! Skipping.", error.line);
+    case ccl_error_invalid_type:
+        return format("Invalid type '%c' at line %i", error.detail, error.line);
+    case ccl_error_missing_separator:
+        return format("Invalid value at line %i. No '=' found", error.line);
+    case ccl_error_invalid_value:
+        if (error.line == 0)
+            return format("Invalid value for '%s'", k);
+        return format("Invalid value for '%s' at line %i", k, error.line);
+    case ccl_error_write:
+        return format("Couldn't write to %s", path.c_str());
+    case ccl_error_watch:
+        return format("Couldn't watch %s", path.c_str());
+    case ccl_error_journal_open:
+        return "Couldn't open journal";
+    case ccl_error_journal_append:
+        return "Couldn't append to journal";
+    case ccl_error_not_found:
+        return format("Value with id '%s' does not exist", k);
+    case ccl_error_replace_type:
+        return format("Can't replace node '%s', because replacement has invalid type '%i'",
+            k, error.detail);
+    case ccl_error_exists:
+        return format("Value with id '%s' already exists", k);
+    case ccl_error_unknown_key:
+        return format("Unknown key '%s'", k);
+    case ccl_error_schema_type:
+        return format("'%s' should be of type %s, using the default value", k, type);
+    case ccl_error_set:
+        return format("Cannot set %s value of '%s'. Doesn't exist or type mismatch", type, k);
+    case ccl_error_get:
+        return format("Cannot get %s value of '%s'. Doesn't exist or type mismatch", type, k);
+    case ccl_error_batch_get:
+        return format("Batch get failed for %i entries, first was '%s'. Doesn't exist, "
+            "type mismatch or invalid value", error.detail, k);
+    case ccl_error_batch_set:
+        return format("Batch set failed for %i entries, first was '%s'. Doesn't exist or type mismatch",
+            error.detail, k);
+    default:
+        return "Unknown error";
+    }
 }
 
 const char* ccl_config::error_to_string(const error_level lvl)
@@ -950,7 +4915,7 @@ const char* ccl_config::error_to_string(const error_level lvl)
     }
 }
 
-data_type ccl_config::util_parse_type(const char c)
+data_type ccl_parser::util_parse_type(const char c)
 {
     switch (c)
     {
@@ -966,6 +4931,14 @@ data_type ccl_config::util_parse_type(const char c)
         return ccl_type_point;
     case '5':
         return ccl_type_rect;
+    case '6':
+        return ccl_type_int64;
+    case '7':
+        return ccl_type_double;
+    case '8':
+        return ccl_type_int_array;
+    case '9':
+        return ccl_type_float_array;
     default:
         return ccl_type_invalid;
     }
@@ -26,8 +26,17 @@
 #define MAX_ERROR_REPORT 5
 
 #include <string>
+#include <string_view>
 #include <map>
+#include <memory>
 #include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <new>
+#include <atomic>
+#include <type_traits>
+#include <utility>
 
 #ifdef LINUX
 #include <errno.h>
@@ -46,14 +55,97 @@ enum data_type
     ccl_type_float,
     ccl_type_point,
     ccl_type_rect,
+    ccl_type_int64,
+    ccl_type_double,
+    /* Comma separated lists, stored as contiguous arrays */
+    ccl_type_int_array,
+    ccl_type_float_array,
 };
 
+/* Flags changing how ccl_config loads and saves files */
+enum load_flags
+{
+    ccl_load_default = 0,
+    /* Map the file into memory instead of reading it.
+       The file shouldn't be modified in place while the config
+       is loaded, since nodes reference the mapping directly */
+    ccl_load_mapped = 1 << 0,
+    /* Changes made with set_* and add_* are appended to
+       '<path>.journal', which load() replays on top of the file.
+       write() and compact() fold the journal back into the file */
+    ccl_load_journal = 1 << 1,
+    /* Parse files bigger than a few MB on multiple threads */
+    ccl_load_parallel = 1 << 2,
+    /* Keep a binary copy of the loaded nodes in <path>.cclb and load
+       that instead of parsing, as long as the file and
+       ccl_load_no_comments don't change */
+    ccl_load_cache = 1 << 3,
+    /* Only index entries while loading and parse values the first
+       time they're read. Invalid values are reported by get_node()
+       and the typed getters instead of load() */
+    ccl_load_lazy = 1 << 4,
+    /* Store each distinct comment and string value copied into the
+       config (by setters, add_* and publish()) only once */
+    ccl_load_intern = 1 << 5,
+    /* Don't keep the comments of loaded entries. Saves memory,
+       but write() saves the file without them */
+    ccl_load_no_comments = 1 << 6,
+};
+
+#ifdef _MSC_VER
+typedef std::wstring ccl_path;
+#else
+typedef std::string ccl_path;
+#endif
+
 enum error_level
 {
     ccl_error_normal,
     ccl_error_fatal
 };
 
+/* What went wrong, see ccl_error */
+enum error_code
+{
+    ccl_error_file_access,
+    ccl_error_header,
+    ccl_error_empty_line,
+    ccl_error_invalid_type,
+    ccl_error_missing_separator,
+    ccl_error_invalid_value,
+    ccl_error_write,
+    ccl_error_watch,
+    ccl_error_journal_open,
+    ccl_error_journal_append,
+    ccl_error_not_found,
+    ccl_error_replace_type,
+    ccl_error_exists,
+    ccl_error_unknown_key,
+    ccl_error_schema_type,
+    ccl_error_set,
+    ccl_error_get,
+    ccl_error_batch_get,
+    ccl_error_batch_set
+};
+
+/* Reported error, only formatted into text by
+   ccl_config::get_error_message() */
+struct ccl_error
+{
+    error_code code;
+    error_level level;
+    /* Line in the file, zero if the error isn't about a line */
+    int line;
+    /* Depends on the code, e.g. the type that was requested */
+    int detail;
+    /* Identifier of the entry, cut off if it doesn't fit */
+    char key[64];
+    uint8_t key_length;
+    bool key_truncated;
+
+    std::string_view get_key() const { return { key, key_length }; }
+};
+
 struct ccl_point
 {
     int x = 0, y = 0;
@@ -65,59 +157,777 @@ struct ccl_rect
         w = 0, h = 0;
 };
 
+/* Elements of an array value, like std::span
+   Converts from C arrays and containers with data() and size() */
+template <class T>
+class ccl_span
+{
+public:
+    constexpr ccl_span() = default;
+    constexpr ccl_span(T* data, const size_t size)
+        : m_data_(data), m_size_(size)
+    {
+    }
+    template <size_t N>
+    constexpr ccl_span(T (&array)[N])
+        : m_data_(array), m_size_(N)
+    {
+    }
+    template <class C, class = std::enable_if_t<!std::is_same<std::decay_t<C>, ccl_span>::value>,
+        class = decltype(std::declval<C&>().data())>
+    constexpr ccl_span(C&& container)
+        : m_data_(container.data()), m_size_(container.size())
+    {
+    }
+
+    constexpr T* data() const { return m_data_; }
+    constexpr size_t size() const { return m_size_; }
+    constexpr bool empty() const { return m_size_ == 0; }
+    constexpr T* begin() const { return m_data_; }
+    constexpr T* end() const { return m_data_ + m_size_; }
+    constexpr T& operator[](const size_t i) const { return m_data_[i]; }
+private:
+    T* m_data_ = nullptr;
+    size_t m_size_ = 0;
+};
+
+/* Bump allocator used by ccl_config for its nodes and strings
+   Memory is given back all at once with reset() or release(), except
+   for allocate_reusable(), which keeps freed blocks for reuse */
+class ccl_arena
+{
+public:
+    ccl_arena() = default;
+    ccl_arena(const ccl_arena&) = delete;
+    ~ccl_arena();
+
+    ccl_arena& operator=(const ccl_arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+    char* allocate_string(size_t length);
+    /* Bytes allocate_reusable() actually reserves for size */
+    static size_t reusable_size(size_t size);
+    /* 8 byte aligned memory, which can be given back with deallocate()
+       and is then reused by allocations of the same size class */
+    void* allocate_reusable(size_t size);
+    /* size is any size of the same class as the allocated one */
+    void deallocate(void* p, size_t size);
+    std::string_view copy(std::string_view str);
+    /* Like copy(), but equal strings are only stored once if
+       interning is enabled. Interned strings must not be modified */
+    std::string_view intern(std::string_view str);
+    /* Whether str is the stored copy of an interned string */
+    bool is_interned(std::string_view str) const;
+
+    template <class T>
+    T* create()
+    {
+        static_assert(alignof(T) <= 8, "allocate_reusable() only aligns to 8 bytes");
+        return new (allocate_reusable(sizeof(T))) T();
+    }
+
+    /* Destroys an object made with create() and reuses its memory */
+    template <class T>
+    void destroy(T* object)
+    {
+        object->~T();
+        deallocate(object, sizeof(T));
+    }
+
+    /* Takes over all memory of another arena */
+    void adopt(ccl_arena& other);
+    /* Frees everything, but keeps the current block for reuse */
+    void reset();
+    /* Frees everything including all blocks */
+    void release();
+
+    /* Bytes in use, not counting freed reusable memory */
+    size_t used() const { return m_used_; }
+    size_t capacity() const { return m_capacity_; }
+    void set_interning(bool enabled) { m_interning_ = enabled; }
+    bool interning() const { return m_interning_; }
+    /* Bytes of distinct interned strings and of their table */
+    size_t interned_bytes() const { return m_interned_bytes_; }
+    size_t intern_table_bytes() const { return m_interned_.capacity() * sizeof(interned); }
+    /* Blocks allocated so far, including those of adopted arenas
+       Not lowered by reset() or release() */
+    uint64_t blocks_allocated() const { return m_blocks_allocated_.load(std::memory_order_relaxed); }
+private:
+    struct block
+    {
+        block* prev;
+        size_t size;
+    };
+
+    struct interned
+    {
+        uint64_t hash;
+        const char* data;
+        size_t length;
+    };
+
+    /* Multiples of 8 bytes up to 128, then powers of two */
+    static constexpr size_t size_classes = 16 + 56;
+    static size_t size_class(size_t size);
+
+    void add_block(size_t min_size);
+    void grow_interned();
+    void clear_interned();
+
+    block* m_block_ = nullptr;
+    char* m_pos_ = nullptr;
+    char* m_end_ = nullptr;
+    size_t m_used_ = 0;
+    size_t m_capacity_ = 0;
+    /* Atomic, so it can be read while the owner allocates */
+    std::atomic<uint64_t> m_blocks_allocated_{ 0 };
+    /* Freed reusable blocks of each size class, linked
+       through their first bytes */
+    void* m_free_[size_classes] = {};
+    /* Open addressing table of interned strings, empty slots have no data */
+    std::vector<interned> m_interned_;
+    size_t m_interned_count_ = 0;
+    size_t m_interned_bytes_ = 0;
+    bool m_interning_ = false;
+};
+
+/* String stored in config entries
+   Either references memory owned by someone else (e.g. the
+   loaded config file) or holds its own copy, which lives on the
+   heap or in an arena. Arena copies are reused if the new string
+   has the same size class and given back to the arena passed to clear() */
+class ccl_str
+{
+public:
+    ccl_str() = default;
+    ccl_str(const ccl_str& other);
+    ~ccl_str();
+
+    /* Copies heap strings, references everything else */
+    ccl_str& operator=(const ccl_str& other);
+
+    /* Copies the string, into the arena if there is one */
+    void assign(std::string_view str, ccl_arena* arena = nullptr);
+    /* Replaces the string with length bytes, which the caller fills
+       in. Returns null if length is zero */
+    char* reset(size_t length, ccl_arena* arena = nullptr);
+    /* References the string, which has to outlive this object */
+    void reference(std::string_view str);
+    /* arena is the one the copy was made in, without
+       one arena copies are only freed with the arena */
+    void clear(ccl_arena* arena = nullptr);
+
+    std::string_view view() const { return { m_data_, m_length_ }; }
+    bool empty() const { return m_length_ == 0; }
+    bool owned() const { return m_storage_ == storage_heap; }
+    /* Whether the string is a reference instead of a copy */
+    bool referenced() const { return m_storage_ == storage_reference; }
+private:
+    enum storage : uint8_t
+    {
+        storage_reference,
+        storage_heap,
+        storage_arena
+    };
+
+    const char* m_data_ = "";
+    size_t m_length_ = 0;
+    storage m_storage_ = storage_reference;
+};
+
 /* Data class that holds config entries
    CCL Will create these automatically */
 class ccl_data
 {
+    friend class ccl_config;
+    friend class ccl_index;
+    friend class ccl_snapshot;
+    friend class ccl_layered_config;
+    template <class T>
+    friend class ccl_handle;
+
 public:
 
     ccl_data() = default;
-    ccl_data(const std::string& id, const std::string& comment, const std::string& val,
+    ccl_data(std::string_view id, std::string_view comment, std::string_view val,
         data_type type);
-    ccl_data(const std::string& id, const std::string& comment, int value);
-    ccl_data(const std::string& id, const std::string& comment, float value);
-    ccl_data(const std::string& id, const std::string& comment, bool value);
-    ccl_data(const std::string& id, const std::string& comment, const std::string& value);
-    ccl_data(const std::string& id, const std::string& comment, int x, int y);
-    ccl_data(const std::string& id, const std::string& comment, int x, int y, int w, int h);
+    ccl_data(std::string_view id, std::string_view comment, int value);
+    ccl_data(std::string_view id, std::string_view comment, float value);
+    ccl_data(std::string_view id, std::string_view comment, bool value);
+    ccl_data(std::string_view id, std::string_view comment, std::string_view value);
+    ccl_data(std::string_view id, std::string_view comment, int x, int y);
+    ccl_data(std::string_view id, std::string_view comment, int x, int y, int w, int h);
 
     ~ccl_data();
 
     ccl_data* get_next() const;
     std::string get_id() const;
+    /* Value formatted as text */
     std::string get_value() const;
     std::string get_comment() const;
     data_type get_type() const;
 
+    /* Same as get_id() and get_comment() without copying
+       Valid until the node is changed or deleted */
+    std::string_view get_id_view() const;
+    std::string_view get_comment_view() const;
+
+    /* Typed values, zero if the type doesn't match */
+    std::string_view get_string() const;
+    int get_int() const;
+    float get_float() const;
+    int64_t get_int64() const;
+    double get_double() const;
+    bool get_bool() const;
+    ccl_point get_point() const;
+    ccl_rect get_rect() const;
+    /* Elements of array values, valid until the node is changed or deleted */
+    ccl_span<const int> get_int_array() const;
+    ccl_span<const float> get_float_array() const;
+
     void set_next(ccl_data* next);
     void set_int(int val);
     void set_float(float val);
+    void set_int64(int64_t val);
+    void set_double(double val);
     void set_bool(bool val);
-    void set_string(const std::string& val);
-    void set_value(const std::string& val, data_type t);
-    void set_comment(const std::string& comment);
+    void set_string(std::string_view val);
+    /* Parses the value as type t, false if it isn't valid */
+    bool set_value(std::string_view val, data_type t);
+    void set_comment(std::string_view comment);
     void set_point(int x, int y);
     void set_rect(int x, int y, int w, int h);
+    /* Copies the elements */
+    void set_int_array(ccl_span<const int> values);
+    void set_float_array(ccl_span<const float> values);
+    /* Typed setter, T is any type of ccl_type_of */
+    template <class T>
+    void set(const T& val);
 private:
+    /* Value as T without checking the type */
+    template <class T>
+    T get_as() const;
     void free();
+    bool parse_value(std::string_view val, data_type t);
+    /* Parses a value as written in a file, escaped is set
+       if it can contain escaped line breaks */
+    bool parse_text(std::string_view val, data_type t, bool escaped);
+    /* Keeps the value as text until resolve() is called */
+    void set_raw(std::string_view val, data_type t, bool escaped);
+    /* Parses the value of nodes loaded with ccl_load_lazy
+       False if it isn't valid */
+    bool resolve() const { return m_raw_ == raw_none || parse_raw(); }
+    bool parse_raw() const;
+    void copy_value(const ccl_data& other);
+    void store(ccl_str& str, std::string_view val);
+    /* store() for comments and string values, which
+       are interned if the arena does that */
+    void share(ccl_str& str, std::string_view val);
+    /* References val and gives the old copy back to the arena */
+    void reference(ccl_str& str, std::string_view val);
+    void copy_str(ccl_str& str, const ccl_str& other);
+    /* Appends the value formatted as text */
+    void append_value(std::string& out, bool escape) const;
+    /* Copies the elements of an array value into m_string_,
+       aligned for them. Arrays aren't interned and reuse the
+       old copy if they fit into it */
+    void store_array(data_type t, const void* data, size_t size);
+    /* Elements of an array value without checking the type */
+    template <class T>
+    ccl_span<const T> array_of() const;
+
+    /* Parsed value, strings and array elements are kept in m_string_ */
+    union value
+    {
+        int i;
+        float f;
+        int64_t l;
+        double d;
+        bool b;
+        ccl_point point;
+        ccl_rect rect;
+
+        value() : rect() {}
+    };
+
+    enum raw_state : uint8_t
+    {
+        raw_none,
+        raw_text,
+        raw_escaped
+    };
 
     data_type m_type_ = ccl_type_invalid;
-    std::string m_id_;
-    std::string m_value_;
-    std::string m_comment_;
+    /* Set while m_string_ holds the unparsed value, see resolve() */
+    mutable raw_state m_raw_ = raw_none;
+    ccl_str m_id_;
+    ccl_str m_string_;
+    ccl_str m_comment_;
+    value m_value_;
     ccl_data* m_next_ = nullptr;
+    ccl_data* m_prev_ = nullptr;
+    /* Set if the node was allocated by a config,
+       its strings are stored there as well */
+    ccl_arena* m_arena_ = nullptr;
+};
+
+/* Defined in ccl.cpp, for every type of ccl_type_of */
+template <> int ccl_data::get_as<int>() const;
+template <> float ccl_data::get_as<float>() const;
+template <> int64_t ccl_data::get_as<int64_t>() const;
+template <> double ccl_data::get_as<double>() const;
+template <> bool ccl_data::get_as<bool>() const;
+template <> ccl_point ccl_data::get_as<ccl_point>() const;
+template <> ccl_rect ccl_data::get_as<ccl_rect>() const;
+template <> std::string ccl_data::get_as<std::string>() const;
+template <> std::vector<int> ccl_data::get_as<std::vector<int>>() const;
+template <> std::vector<float> ccl_data::get_as<std::vector<float>>() const;
+
+/* Open addressing hash table mapping identifiers to nodes
+   Used by ccl_config so lookups don't have to walk the node list
+   The index doesn't own the nodes it points to */
+class ccl_index
+{
+    friend class ccl_config;
+    friend class ccl_layered_config;
+public:
+    ccl_data* find(std::string_view id) const;
+    /* Same as find(id), with the hash of id computed beforehand */
+    ccl_data* find(std::string_view id, uint64_t hash) const;
+    /* Hints that the slot of hash will be looked up soon */
+    void prefetch(uint64_t hash) const;
+    void insert(ccl_data* node);
+    void erase(const ccl_data* node);
+    void clear();
+    /* Makes room for count nodes without growing */
+    void reserve(size_t count);
+
+    size_t size() const;
+
+    /* FNV-1a, can be computed at compile time */
+    static constexpr uint64_t hash(const char* str, size_t len)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < len; i++)
+        {
+            h ^= static_cast<unsigned char>(str[i]);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+private:
+    struct slot
+    {
+        uint64_t hash;
+        ccl_data* node;
+    };
+
+    void rehash(size_t size);
+
+    std::vector<slot> m_slots_;
+    size_t m_size_ = 0;
+};
+
+/* Contents of a config file, either mapped or read into memory
+   Nodes loaded from the file reference this memory directly */
+class ccl_buffer
+{
+public:
+    ccl_buffer() = default;
+    ccl_buffer(const ccl_buffer&) = delete;
+    ~ccl_buffer();
+
+    ccl_buffer& operator=(const ccl_buffer&) = delete;
+
+    bool open(const ccl_path& path, bool map);
+    /* Copies data instead of reading a file */
+    void assign(const char* data, size_t size);
+    void close();
+
+    const char* data() const { return m_data_; }
+    size_t size() const { return m_size_; }
+    bool mapped() const { return m_mapped_; }
+private:
+    char* m_data_ = nullptr;
+    size_t m_size_ = 0;
+    bool m_mapped_ = false;
+};
+
+/* Immutable copy of all nodes of a config, published with
+   ccl_config::publish(). Any number of threads can read from
+   it without locking. Getters never report errors and return
+   zero or empty values for missing keys or type mismatches */
+class ccl_snapshot
+{
+    friend class ccl_config;
+public:
+    ccl_snapshot(const ccl_snapshot&) = delete;
+    ccl_snapshot& operator=(const ccl_snapshot&) = delete;
+
+    /* Increases with every published snapshot */
+    uint64_t get_version() const;
+    const ccl_data* get_first() const;
+    const ccl_data* get_node(std::string_view id) const;
+    bool node_exists(std::string_view id) const;
+
+    int get_int(std::string_view id) const;
+    int get_hex(std::string_view id) const;
+    float get_float(std::string_view id) const;
+    int64_t get_int64(std::string_view id) const;
+    double get_double(std::string_view id) const;
+    bool get_bool(std::string_view id) const;
+    std::string get_string(std::string_view id) const;
+    /* String values without copying, valid as long as the snapshot */
+    std::string_view get_string_view(std::string_view id) const;
+    int get_point_x(std::string_view id) const;
+    int get_point_y(std::string_view id) const;
+    int get_rect_x(std::string_view id) const;
+    int get_rect_y(std::string_view id) const;
+    int get_rect_w(std::string_view id) const;
+    int get_rect_h(std::string_view id) const;
+    ccl_point get_point(std::string_view id) const;
+    ccl_rect get_rect(std::string_view id) const;
+    /* Valid as long as the snapshot */
+    ccl_span<const int> get_int_array(std::string_view id) const;
+    ccl_span<const float> get_float_array(std::string_view id) const;
+private:
+    ccl_snapshot() = default;
+
+    uint64_t m_version_ = 0;
+    ccl_data* m_first_node_ = nullptr;
+    ccl_index m_index_;
+    ccl_arena m_arena_;
+};
+
+struct ccl_hazard_slot;
+
+/* Keeps a snapshot alive while it's being read
+   Acquiring and releasing it is lock free for any number
+   of readers. Don't keep it
+   around longer than needed, as old snapshots can only be
+   freed once no reader is using them anymore */
+class ccl_snapshot_ref
+{
+public:
+    explicit ccl_snapshot_ref(const std::atomic<ccl_snapshot*>& source);
+    ccl_snapshot_ref(ccl_snapshot_ref&& other) noexcept;
+    ccl_snapshot_ref(const ccl_snapshot_ref&) = delete;
+    ~ccl_snapshot_ref();
+
+    ccl_snapshot_ref& operator=(const ccl_snapshot_ref&) = delete;
+
+    /* Null if nothing was published yet */
+    const ccl_snapshot* get() const { return m_snapshot_; }
+    const ccl_snapshot* operator->() const { return m_snapshot_; }
+    explicit operator bool() const { return m_snapshot_ != nullptr; }
+private:
+    const ccl_snapshot* m_snapshot_ = nullptr;
+    ccl_hazard_slot* m_slot_ = nullptr;
+};
+
+/* Data type of the values of type T */
+template <class T>
+struct ccl_type_of;
+
+template <> struct ccl_type_of<int> { static constexpr data_type value = ccl_type_int; };
+template <> struct ccl_type_of<float> { static constexpr data_type value = ccl_type_float; };
+template <> struct ccl_type_of<int64_t> { static constexpr data_type value = ccl_type_int64; };
+template <> struct ccl_type_of<double> { static constexpr data_type value = ccl_type_double; };
+template <> struct ccl_type_of<bool> { static constexpr data_type value = ccl_type_bool; };
+template <> struct ccl_type_of<std::string> { static constexpr data_type value = ccl_type_string; };
+template <> struct ccl_type_of<ccl_point> { static constexpr data_type value = ccl_type_point; };
+template <> struct ccl_type_of<ccl_rect> { static constexpr data_type value = ccl_type_rect; };
+template <> struct ccl_type_of<std::vector<int>> { static constexpr data_type value = ccl_type_int_array; };
+template <> struct ccl_type_of<std::vector<float>> { static constexpr data_type value = ccl_type_float_array; };
+
+/* Key of a schema, declared with CCL_KEY */
+struct ccl_schema_entry
+{
+    std::string_view id;
+    uint64_t hash;
+    data_type type;
+    /* Sets a node to the default value of the key */
+    void (*set_default)(ccl_data* node);
+
+    template <class Key>
+    static void store_default(ccl_data* node)
+    {
+        node->set<typename Key::type>(Key::default_value());
+    }
+};
+
+/* Declares a key for schemas and ccl_config::get<key>()
+   The type is any type of ccl_type_of, the default
+   value is passed to its constructor:
+   CCL_KEY(window_rect, ccl_rect, "window_rect", 0, 0, 640, 480); */
+#define CCL_KEY(name, value_type, key_id, ...) \
+    struct name \
+    { \
+        using type = value_type; \
+        static constexpr std::string_view id = key_id; \
+        static constexpr uint64_t hash = ccl_index::hash(key_id, sizeof(key_id) - 1); \
+        static type default_value() { return type{ __VA_ARGS__ }; } \
+    }
+
+/* Keys a config is checked against, see ccl_config::set_schema() */
+template <class... Keys>
+struct ccl_schema
+{
+    static constexpr ccl_schema_entry entries[] = {
+        { Keys::id, Keys::hash, ccl_type_of<typename Keys::type>::value,
+            &ccl_schema_entry::store_default<Keys> }...
+    };
+};
+
+/* Counters of a ccl_config, see ccl_config::get_stats()
+   Counting can be compiled out by defining CCL_NO_STATS */
+template <class T>
+struct ccl_stats_of
+{
+    /* Arrays are indexed by the data_type of the getter */
+    static constexpr size_t type_count = ccl_type_float_array + 1;
+
+    /* Calls of get_node() and how many found nothing */
+    T lookups{};
+    T lookup_misses{};
+    /* Typed getters that found an entry of their type or didn't */
+    T get_hits[type_count]{};
+    T get_misses[type_count]{};
+    /* Misses where the entry exists with another type */
+    T type_mismatches{};
+    /* Entries read from files, journals and reloads */
+    T entries_parsed{};
+    T bytes_read{};
+    T bytes_written{};
+    T loads{};
+    T writes{};
+    /* Time spent in load() and write() */
+    T load_ns{};
+    T write_ns{};
+    /* Memory blocks allocated for nodes and strings */
+    T allocations{};
+};
+
+typedef ccl_stats_of<uint64_t> ccl_stats;
+
+/* Bytes used by a ccl_config, see ccl_config::memory_usage()
+   Strings referencing a loaded file are part of files or mapped */
+struct ccl_memory_usage
+{
+    /* The entries themselves */
+    size_t nodes = 0;
+    /* Copies of identifiers, comments and string values */
+    size_t ids = 0;
+    size_t comments = 0;
+    size_t values = 0;
+    /* Distinct interned strings and their table, see ccl_load_intern */
+    size_t interned = 0;
+    /* Hash index and the sorted index of prefix queries */
+    size_t index = 0;
+    /* Files read into memory */
+    size_t files = 0;
+    /* Mapped files, which are shared with the page cache
+       and therefore not part of total */
+    size_t mapped = 0;
+    /* Arena memory that isn't used yet or was freed for reuse */
+    size_t unused = 0;
+    /* Padding, journal buffer, header and schema */
+    size_t other = 0;
+    size_t total = 0;
+};
+
+/* Binds an entry to a variable for ccl_config::get_batch() and
+   set_batch(). T is any type of ccl_type_of, the hash of the
+   identifier is computed once when the binding is created:
+   ccl_binding bindings[] = { { "width", &settings.width }, ... }; */
+struct ccl_binding
+{
+    std::string_view id;
+    uint64_t hash;
+    data_type type;
+    void* target;
+
+    template <class T>
+    constexpr ccl_binding(const std::string_view id, T* target)
+        : id(id), hash(ccl_index::hash(id.data(), id.length())),
+          type(ccl_type_of<T>::value), target(target)
+    {
+    }
+};
+
+/* Outcome of a batch read or write */
+struct ccl_batch_result
+{
+    /* Bindings that were read or written */
+    size_t done = 0;
+    /* Bindings whose entry doesn't exist */
+    size_t missing = 0;
+    /* Bindings whose entry has a different type */
+    size_t mismatched = 0;
+    /* Bindings whose lazily loaded value isn't valid, only for get_batch() */
+    size_t invalid = 0;
+
+    bool ok() const { return missing == 0 && mismatched == 0 && invalid == 0; }
+};
+
+/* Entry in config text, views point into the text */
+struct ccl_entry
+{
+    data_type type;
+    std::string_view id;
+    /* Value as written in the file, line breaks are still escaped */
+    std::string_view value;
+    /* Comment in the line before, empty if there is none */
+    std::string_view comment;
+    bool has_comment;
+    /* The line contains a backslash */
+    bool escaped;
+    int line;
+};
+
+/* Reads config text entry by entry without creating nodes
+   Files and streams are read in blocks, only the current block
+   is kept in memory. It only grows if a line doesn't fit */
+class ccl_parser
+{
+    friend class ccl_config;
+public:
+    /* Called for every entry, the views are only valid during the call */
+    typedef void (*entry_fn)(const ccl_entry& entry, void* user);
+    /* Called for lines that couldn't be read, which are skipped */
+    typedef void (*error_fn)(error_code code, int line, int detail, void* user);
+
+    explicit ccl_parser(size_t block_size = 1 << 16);
+
+    void set_error_handler(error_fn fn, void* user);
+
+    /* False if the file can't be opened or read */
+    bool parse_file(const ccl_path& path, entry_fn fn, void* user);
+    /* Reads until the end of the stream, false on read errors */
+    bool parse_stream(FILE* stream, entry_fn fn, void* user);
+    /* Reads text that is already in memory */
+    void parse_text(std::string_view text, entry_fn fn, void* user);
+
+    /* Same as above, calling on_entry(const ccl_entry&) */
+    template <class F>
+    bool parse_file(const ccl_path& path, F&& on_entry)
+    {
+        return parse_file(path, &call<std::remove_reference_t<F>>, user_of(on_entry));
+    }
+    template <class F>
+    bool parse_stream(FILE* stream, F&& on_entry)
+    {
+        return parse_stream(stream, &call<std::remove_reference_t<F>>, user_of(on_entry));
+    }
+    template <class F>
+    void parse_text(std::string_view text, F&& on_entry)
+    {
+        parse_text(text, &call<std::remove_reference_t<F>>, user_of(on_entry));
+    }
+
+    /* Comment in the first line of the last text that was read */
+    const std::string& get_header() const;
+
+    static data_type util_parse_type(char c);
+private:
+    template <class F>
+    static void call(const ccl_entry& entry, void* user)
+    {
+        (*static_cast<F*>(user))(entry);
+    }
+    template <class F>
+    static void* user_of(F& fn)
+    {
+        return const_cast<void*>(static_cast<const void*>(&fn));
+    }
+
+    /* Splits config text into entries and calls on_entry for each
+       The first line is read into header if it's a comment and
+       header isn't null. Invalid lines are passed to
+       report(code, line, detail). Returns the line after the text */
+    template <class R, class F>
+    static int tokenize(const char* begin, const char* end, int line,
+        std::string_view* header, R&& report, F&& on_entry);
+
+    size_t m_block_size_;
+    error_fn m_error_fn_ = nullptr;
+    void* m_error_user_ = nullptr;
+    std::string m_header_;
+};
+
+class ccl_config;
+class ccl_section;
+
+/* Nodes sorted by identifier, see ccl_config::get_prefix()
+   Only valid until nodes are added to or deleted from the config */
+class ccl_node_range
+{
+public:
+    ccl_node_range() = default;
+    ccl_node_range(ccl_data* const* begin, ccl_data* const* end)
+        : m_begin_(begin), m_end_(end)
+    {
+    }
+
+    ccl_data* const* begin() const { return m_begin_; }
+    ccl_data* const* end() const { return m_end_; }
+    size_t size() const { return static_cast<size_t>(m_end_ - m_begin_); }
+    bool empty() const { return m_begin_ == m_end_; }
+    ccl_data* operator[](const size_t i) const { return m_begin_[i]; }
+private:
+    ccl_data* const* m_begin_ = nullptr;
+    ccl_data* const* m_end_ = nullptr;
+};
+
+/* Typed reference to an entry, created with ccl_config::handle()
+   Reading and writing only goes through the node pointer, the
+   identifier is only looked up again if nodes were deleted since
+   (e.g. by reloading). Values are zero if the entry doesn't exist
+   or has a different type. The config has to outlive its handles */
+template <class T>
+class ccl_handle
+{
+    friend class ccl_config;
+public:
+    static constexpr data_type type = ccl_type_of<T>::value;
+
+    ccl_handle() = default;
+
+    /* True if the entry exists and is of type T */
+    bool valid() const;
+    explicit operator bool() const { return valid(); }
+
+    T get() const;
+    T operator*() const { return get(); }
+    /* Sets the value like ccl_config::set_* */
+    void set(const T& val);
+    ccl_handle& operator=(const T& val) { set(val); return *this; }
+
+    ccl_data* node() const;
+private:
+    ccl_handle(ccl_config* config, std::string id);
+
+    ccl_config* m_config_ = nullptr;
+    std::string m_id_;
+    mutable ccl_data* m_node_ = nullptr;
+    mutable uint64_t m_generation_ = 0;
 };
 
 /* Class holding all information and data of a config file */
 class ccl_config
 {
+    template <class T>
+    friend class ccl_handle;
+    friend class ccl_layered_config;
 public:
     ccl_config();
     /* Constructor for CCL config
        Supports Unicode paths */
-    ccl_config(const std::string& path, std::string header);
+    ccl_config(const std::string& path, std::string header,
+        unsigned flags = ccl_load_default);
 #ifdef _MSC_VER
-    ccl_config(std::wstring path, std::string header);
+    ccl_config(std::wstring path, std::string header,
+        unsigned flags = ccl_load_default);
 #endif
 
     ~ccl_config();
@@ -126,6 +936,36 @@ public:
     void load();
     void write(bool comments = true);
 
+    /* Flags used by load() (See load_flags) */
+    void set_flags(unsigned flags);
+    unsigned get_flags() const;
+
+    /* Starts or stops watching the config file for changes made by
+       other programs. Uses inotify on Linux, and compares the
+       modification time in poll_changes() everywhere else.
+       Changes are diffed against the file as it is when watching starts */
+    bool watch(bool enable = true);
+    /* Applies changes to the file made since it was loaded or written
+       Only entries in the changed part of the file are parsed again
+       and only entries that actually changed are touched. Pointers to
+       all other nodes stay valid, removed entries are deleted.
+       Publishes a new snapshot if one was published before.
+       True if anything was reloaded */
+    bool poll_changes();
+
+    /* Copies all nodes into a new snapshot and makes it the current one
+       Only one thread can modify the config and publish at a time */
+    void publish();
+    /* Current snapshot for readers, can be used from any thread
+       concurrently with modifications and publish() */
+    ccl_snapshot_ref snapshot() const;
+
+    /* Journal mode: Writes the config and clears the journal */
+    void compact();
+    /* Journal mode: Journal size in bytes after which it's compacted
+       automatically, zero disables compaction. Default is 1MB */
+    void set_journal_limit(size_t bytes);
+
     ccl_data* get_first() const;
 
     /* True if the file didn't exist our couldn't be loaded */
@@ -135,70 +975,191 @@ public:
     /* True if file exists and can be accessed */
     bool can_load() const;
     /* True if config value could be found by identifier */
-    bool node_exists(const std::string& id);
+    bool node_exists(std::string_view id);
     /* Get data node by identifier */
-    ccl_data* get_node(const std::string& id, bool silent = false);
+    ccl_data* get_node(std::string_view id, bool silent = false);
+
+    /* Entries whose identifier starts with prefix, sorted by identifier
+       The sorted order is built on the first call and kept up to date
+       by adding and deleting entries after that, which moves the
+       entries behind them. Queries don't look at other keys */
+    ccl_node_range get_prefix(std::string_view prefix);
+    /* Amount of entries whose identifier starts with prefix */
+    size_t count_prefix(std::string_view prefix);
+    /* Deletes all entries whose identifier starts with prefix and
+       returns how many there were. In journal mode the config is
+       compacted, since the journal can't record deleted entries */
+    size_t remove_prefix(std::string_view prefix);
+    /* Entries named "<name>.<id>", e.g. section("render").get_int("w")
+       reads "render.w". The config has to outlive the section */
+    ccl_section section(std::string_view name);
+    /* Typed handle for fast repeated access to an entry
+       T is any type of ccl_type_of */
+    template <class T>
+    ccl_handle<T> handle(std::string_view id)
+    {
+        return ccl_handle<T>(this, std::string(id));
+    }
+
+    /* Checks the config against a schema now and after every load
+       Keys that are missing or have a different type are set to
+       their default value, keys that aren't in the schema are
+       reported as errors */
+    template <class Schema>
+    void set_schema()
+    {
+        set_schema(Schema::entries, sizeof(Schema::entries) / sizeof(ccl_schema_entry));
+    }
+    void set_schema(const ccl_schema_entry* entries, size_t count);
 
-    /* Adds a new data node (Use type specific methods instead) */
+    /* Reads out a key declared with CCL_KEY
+       The hash of the identifier is computed at compile time */
+    template <class Key>
+    typename Key::type get()
+    {
+        using type = typename Key::type;
+        const auto node = m_index_.find(Key::id, Key::hash);
+
+        /* The schema makes sure the type matches, unless it was
+           changed by replacing the node afterwards */
+        if (node && node->m_type_ == ccl_type_of<type>::value && node->resolve())
+            return node->template get_as<type>();
+        return Key::default_value();
+    }
+
+    /* Sets a key declared with CCL_KEY, adds it if it doesn't exist */
+    template <class Key>
+    void set(const typename Key::type& val)
+    {
+        auto node = m_index_.find(Key::id, Key::hash);
+
+        if (node && node->m_type_ == ccl_type_of<typename Key::type>::value)
+        {
+            node->set(val);
+            journal(node, false);
+        }
+        else
+        {
+            node = create_node(Key::id, {});
+            node->set(val);
+            add_node(node, true);
+        }
+    }
+
+    /* Reads all bindings into their targets. Targets of entries that
+       don't exist, have a different type or an invalid value are left
+       as they are and reported as a single error, unless silent is set */
+    ccl_batch_result get_batch(const ccl_binding* bindings, size_t count,
+        bool silent = false);
+    template <size_t N>
+    ccl_batch_result get_batch(const ccl_binding (&bindings)[N], bool silent = false)
+    {
+        return get_batch(bindings, N, silent);
+    }
+    /* Writes the targets of all bindings into existing entries of
+       the same type, failures are reported as a single error */
+    ccl_batch_result set_batch(const ccl_binding* bindings, size_t count);
+    template <size_t N>
+    ccl_batch_result set_batch(const ccl_binding (&bindings)[N])
+    {
+        return set_batch(bindings, N);
+    }
+
+    /* Adds a new data node (Use type specific methods instead)
+       The config takes ownership of the node. If it can't be added
+       or is merged into an existing node it'll be deleted */
     void add_node(ccl_data* node, bool replace = false);
     /* Adds a new value of type int */
-    void add_int(const std::string& id, const std::string& comment, int val,
+    void add_int(std::string_view id, std::string_view comment, int val,
         bool replace = false);
     /* Adds a new value of type float */
-    void add_float(const std::string& id, const std::string& comment, float val,
+    void add_float(std::string_view id, std::string_view comment, float val,
+        bool replace = false);
+    /* Adds a new value of type int64 */
+    void add_int64(std::string_view id, std::string_view comment, int64_t val,
+        bool replace = false);
+    /* Adds a new value of type double */
+    void add_double(std::string_view id, std::string_view comment, double val,
         bool replace = false);
     /* Adds a new value of type boolean */
-    void add_bool(const std::string& id, const std::string& comment, bool val,
+    void add_bool(std::string_view id, std::string_view comment, bool val,
         bool replace = false);
     /* Adds a new value of type string */
-    void add_string(const std::string& id, const std::string& comment, const std::string& val,
+    void add_string(std::string_view id, std::string_view comment, std::string_view val,
         bool replace = false);
     /* Adds a new value of type point (x and y values) */
-    void add_point(const std::string& id, const std::string& comment, int x, int y,
+    void add_point(std::string_view id, std::string_view comment, int x, int y,
         bool replace = false);
     /* Adds a new value of type rect (x, y, w and h values) */
-    void add_rect(const std::string& id, const std::string& comment,
+    void add_rect(std::string_view id, std::string_view comment,
         int x, int y, int w, int h, bool replace = false);
+    /* Adds a new value of type int array, the elements are copied */
+    void add_int_array(std::string_view id, std::string_view comment,
+        ccl_span<const int> values, bool replace = false);
+    /* Adds a new value of type float array, the elements are copied */
+    void add_float_array(std::string_view id, std::string_view comment,
+        ccl_span<const float> values, bool replace = false);
 
     /* Sets an entry to a new value if it exists */
-    void set_int(const std::string& id, int val);
+    void set_int(std::string_view id, int val);
     /* Sets an entry to a new value if it exists */
-    void set_float(const std::string& id, float val);
+    void set_float(std::string_view id, float val);
     /* Sets an entry to a new value if it exists */
-    void set_bool(const std::string& id, bool val);
+    void set_int64(std::string_view id, int64_t val);
     /* Sets an entry to a new value if it exists */
-    void set_string(const std::string& id, const std::string& val);
+    void set_double(std::string_view id, double val);
     /* Sets an entry to a new value if it exists */
-    void set_point(const std::string& id, int x, int y);
+    void set_bool(std::string_view id, bool val);
     /* Sets an entry to a new value if it exists */
-    void set_rect(const std::string& id, int x, int y, int w, int h);
+    void set_string(std::string_view id, std::string_view val);
+    /* Sets an entry to a new value if it exists */
+    void set_point(std::string_view id, int x, int y);
+    /* Sets an entry to a new value if it exists */
+    void set_rect(std::string_view id, int x, int y, int w, int h);
+    /* Sets an entry to a new value if it exists */
+    void set_int_array(std::string_view id, ccl_span<const int> values);
+    /* Sets an entry to a new value if it exists */
+    void set_float_array(std::string_view id, ccl_span<const float> values);
 
     /* Reads out a value if it exists */
-    int get_int(const std::string& id, bool silent = false);
+    int get_int(std::string_view id, bool silent = false);
+    /* Reads out a value if it exists */
+    int get_hex(std::string_view id, bool silent = false);
+    /* Reads out a value if it exists */
+    float get_float(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    int get_hex(const std::string& id, bool silent = false);
+    int64_t get_int64(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    float get_float(const std::string& id, bool silent = false);
+    double get_double(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    bool get_bool(const std::string& id, bool silent = false);
+    bool get_bool(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    std::string get_string(const std::string& id, bool silent = false);
+    std::string get_string(std::string_view id, bool silent = false);
+    /* Reads out a string value without copying it
+       Valid until the entry is changed or deleted */
+    std::string_view get_string_view(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    int get_point_x(const std::string& id, bool silent = false);
+    int get_point_x(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    int get_point_y(const std::string& id, bool silent = false);
+    int get_point_y(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    int get_rect_x(const std::string& id, bool silent = false);
+    int get_rect_x(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    int get_rect_y(const std::string& id, bool silent = false);
+    int get_rect_y(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    int get_rect_w(const std::string& id, bool silent = false);
+    int get_rect_w(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    int get_rect_h(const std::string& id, bool silent = false);
+    int get_rect_h(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    ccl_point get_point(const std::string& id, bool silent = false);
+    ccl_point get_point(std::string_view id, bool silent = false);
     /* Reads out a value if it exists */
-    ccl_rect get_rect(const std::string& id, bool silent = false);
+    ccl_rect get_rect(std::string_view id, bool silent = false);
+    /* Reads out the elements of an array without copying them
+       Valid until the entry is changed or deleted */
+    ccl_span<const int> get_int_array(std::string_view id, bool silent = false);
+    /* Reads out the elements of an array without copying them
+       Valid until the entry is changed or deleted */
+    ccl_span<const float> get_float_array(std::string_view id, bool silent = false);
 
     /* Errors 
        True if any errors were reported
@@ -216,24 +1177,276 @@ public:
        the amount of total errors */
     std::string get_error_message();
 
+    /* Amount of errors reported in total */
+    size_t get_error_count() const;
+    /* Recent errors, zero is the latest one. Only the last
+       MAX_ERROR_REPORT errors are kept, null for older ones */
+    const ccl_error* get_error(size_t i) const;
+
+    /* Counters since the config was created or reset_stats()
+       get_stats() can be called from other threads while the config
+       is in use, reset_stats() only from the thread using it */
+    ccl_stats get_stats() const;
+    void reset_stats();
+
+    /* Breaks down the memory used by the config. Walks all
+       entries, so it's meant for diagnostics */
+    ccl_memory_usage memory_usage() const;
+
 private:
-    void add_error(const std::string& error_msg, error_level lvl);
+    /* Records an error, repeats of kept errors are ignored */
+    void add_error(error_code code, error_level lvl, std::string_view key = {},
+        int line = 0, int detail = 0);
+    void add_error(const ccl_error& error);
+    std::string format_error(const ccl_error& error) const;
 
     static const char* error_to_string(error_level lvl);
 
-    static data_type util_parse_type(char c);
+    /* Creates nodes from config text. The text has to stay valid
+       as long as the nodes reference it */
+    void parse(const char* begin, const char* end, bool replay = false);
+    /* Parses big files on multiple threads, false if the
+       file is too small to be split up */
+    bool parse_parallel(const char* begin, const char* end);
+    /* Reads the value of an entry into a node, false if it's invalid */
+    bool read_value(ccl_data* node, const ccl_entry& e);
+
+    ccl_path cache_path() const;
+    /* Loads nodes from the binary cache if it was made from text */
+    bool load_cache(const ccl_buffer& text);
+    void write_cache(const ccl_buffer& text);
+
+    ccl_path journal_path() const;
+    void replay_journal();
+    /* Appends the current state of a node to the journal */
+    void journal(const ccl_data* node, bool comment);
+    void clear_journal();
 
-    std::map<std::string, error_level> m_errors_;
+    /* Frees retired snapshots no reader is using anymore */
+    void reclaim_snapshots(bool wait);
+
+    /* Formats all nodes like they're stored in files */
+    void serialize(std::string& out, bool comments) const;
+
+    /* Allocates a node in the arena */
+    ccl_data* create_node(std::string_view id, std::string_view comment);
+    /* Deletes heap nodes, arena nodes are freed with the arena */
+    void destroy_node(ccl_data* node);
+    /* Unlinks a node and destroys it */
+    void remove_node(ccl_data* node);
+    /* Checks all nodes against the schema, if there is one */
+    void check_schema();
+    /* get_node() for typed getters, null and reported
+       unless silent if the type doesn't match */
+    ccl_data* get_typed_node(std::string_view id, data_type type, bool silent);
+    /* Positions of the nodes starting with prefix in m_sorted_ */
+    std::pair<size_t, size_t> prefix_range(std::string_view prefix);
+    /* Keep m_sorted_ up to date for a node that was just added
+       or is about to be removed, if it was up to date before */
+    void sort_in(ccl_data* node);
+    void sort_out(ccl_data* node);
+
+    /* Comment of a loaded entry, empty with ccl_load_no_comments */
+    std::string_view loaded_comment(std::string_view comment) const
+    {
+        return (m_flags_ & ccl_load_no_comments) ? std::string_view() : comment;
+    }
+
+    /* Remembers buffer as the last known contents of the file */
+    void set_source(ccl_buffer* buffer);
+    /* Copies strings that reference loaded files and frees the files */
+    void release_buffers();
+    /* Diffs the file against the last known contents */
+    bool reload_changes();
+
+    /* Ring of the last errors, m_error_count_ % MAX_ERROR_REPORT
+       is where the next one goes */
+    ccl_error m_errors_[MAX_ERROR_REPORT];
+    size_t m_error_count_ = 0;
+    /* Increased whenever nodes are deleted, handles
+       look up their node again if it changed */
+    uint64_t m_generation_ = 1;
+    /* Increased whenever nodes are added or deleted */
+    uint64_t m_revision_ = 1;
+    /* Updated with relaxed atomics. allocations starts at minus the
+       blocks of m_arena_ at the last reset, get_stats() adds them */
+    ccl_stats_of<std::atomic<uint64_t>> m_stats_;
+    /* All nodes sorted by identifier for prefix queries, only up to
+       date if m_sorted_revision_ is m_revision_. Sorted on the first
+       query, after that nodes are inserted into and erased from it */
+    std::vector<ccl_data*> m_sorted_;
+    uint64_t m_sorted_revision_ = 0;
     bool m_empty_ = true;
     bool m_fatal_errors_ = false;
     ccl_data* m_first_node_;
+    ccl_index m_index_;
+    ccl_arena m_arena_;
+    /* Nodes passed to add_node that weren't allocated by the arena */
+    size_t m_heap_nodes_ = 0;
+    std::vector<std::unique_ptr<ccl_buffer>> m_buffers_;
+    unsigned m_flags_ = ccl_load_default;
+    /* Set while nodes are loaded, which aren't journaled */
+    bool m_loading_ = false;
+    FILE* m_journal_ = nullptr;
+    size_t m_journal_size_ = 0;
+    size_t m_journal_limit_ = 1 << 20;
+    std::string m_journal_buffer_;
+    std::atomic<ccl_snapshot*> m_snapshot_{ nullptr };
+    std::vector<ccl_snapshot*> m_retired_snapshots_;
+    uint64_t m_snapshot_version_ = 0;
+    /* Last known contents of the file, one of m_buffers_ or m_written_ */
+    ccl_buffer* m_source_ = nullptr;
+    /* What write() wrote last while watching, or what watch() read
+       after an earlier write. No node references it */
+    std::unique_ptr<ccl_buffer> m_written_;
+    int64_t m_source_time_ = 0;
+    uint64_t m_source_size_ = 0;
+    /* Set by write() while not watching, watch() reads the file again */
+    bool m_source_outdated_ = false;
+    bool m_watching_ = false;
+    int m_watch_fd_ = -1;
+    std::string m_watch_name_;
+    /* Schema entries sorted by hash */
+    std::vector<const ccl_schema_entry*> m_schema_;
     std::string m_header_;
 
-#ifdef _MSC_VER
-    std::wstring m_path_;
-#else
-	std::string m_path_;
-#endif
+    ccl_path m_path_;
+};
+
+/* Entries of a config with a common dotted prefix, created
+   with ccl_config::section(). Identifiers are relative to it */
+class ccl_section
+{
+public:
+    ccl_section(ccl_config* config, std::string_view name);
+
+    /* Section "<name>.<sub>" of this one */
+    ccl_section section(std::string_view sub) const;
+    /* Prefix of all identifiers, the name followed by a dot */
+    std::string_view get_prefix() const;
+
+    /* Entries of this section and all sections within */
+    ccl_node_range entries();
+    size_t count();
+    /* Deletes all entries, see ccl_config::remove_prefix() */
+    size_t remove();
+
+    bool node_exists(std::string_view id);
+    ccl_data* get_node(std::string_view id, bool silent = false);
+
+    /* Same as the ccl_config methods with the prefix added */
+    int get_int(std::string_view id, bool silent = false);
+    float get_float(std::string_view id, bool silent = false);
+    int64_t get_int64(std::string_view id, bool silent = false);
+    double get_double(std::string_view id, bool silent = false);
+    bool get_bool(std::string_view id, bool silent = false);
+    std::string get_string(std::string_view id, bool silent = false);
+    std::string_view get_string_view(std::string_view id, bool silent = false);
+    ccl_point get_point(std::string_view id, bool silent = false);
+    ccl_rect get_rect(std::string_view id, bool silent = false);
+    ccl_span<const int> get_int_array(std::string_view id, bool silent = false);
+    ccl_span<const float> get_float_array(std::string_view id, bool silent = false);
+
+    void set_int(std::string_view id, int val);
+    void set_float(std::string_view id, float val);
+    void set_int64(std::string_view id, int64_t val);
+    void set_double(std::string_view id, double val);
+    void set_bool(std::string_view id, bool val);
+    void set_string(std::string_view id, std::string_view val);
+    void set_point(std::string_view id, int x, int y);
+    void set_rect(std::string_view id, int x, int y, int w, int h);
+    void set_int_array(std::string_view id, ccl_span<const int> values);
+    void set_float_array(std::string_view id, ccl_span<const float> values);
+private:
+    /* Full identifier of id, valid until the next call */
+    std::string_view key(std::string_view id);
+
+    ccl_config* m_config_;
+    size_t m_prefix_length_;
+    /* Starts with the prefix, the rest is reused by key() */
+    std::string m_key_;
+};
+
+/* Configs stacked by priority, e.g. defaults, site and user files
+   Entries are read from the highest layer that has them, through
+   one merged index. The index is rebuilt when nodes were added to
+   or deleted from a layer since. Layers have to outlive this */
+class ccl_layered_config
+{
+public:
+    /* Adds a layer above all others, which becomes the write layer */
+    void add_layer(ccl_config* config);
+    size_t get_layer_count() const;
+    /* Zero is the lowest layer */
+    ccl_config* get_layer(size_t i) const;
+
+    /* Layer that set_* writes to */
+    void set_write_layer(size_t i);
+    size_t get_write_layer() const;
+
+    /* Node of the highest layer that has id, null if none has it */
+    ccl_data* get_node(std::string_view id);
+    /* Highest layer that has id, -1 if none has it */
+    int get_owner(std::string_view id);
+    bool node_exists(std::string_view id);
+
+    /* Values are zero if no layer has the entry or its type differs
+       Missing entries aren't reported, since lower layers usually
+       have all of them */
+    int get_int(std::string_view id);
+    float get_float(std::string_view id);
+    int64_t get_int64(std::string_view id);
+    double get_double(std::string_view id);
+    bool get_bool(std::string_view id);
+    std::string get_string(std::string_view id);
+    /* Same as get_string() without copying, see ccl_data::get_string() */
+    std::string_view get_string_view(std::string_view id);
+    ccl_point get_point(std::string_view id);
+    ccl_rect get_rect(std::string_view id);
+    ccl_span<const int> get_int_array(std::string_view id);
+    ccl_span<const float> get_float_array(std::string_view id);
+
+    /* Sets an entry in the write layer. If only a lower layer has it,
+       it's added to the write layer with the same comment. Entries no
+       layer has or with a different type are reported by the write layer */
+    void set_int(std::string_view id, int val);
+    void set_float(std::string_view id, float val);
+    void set_int64(std::string_view id, int64_t val);
+    void set_double(std::string_view id, double val);
+    void set_bool(std::string_view id, bool val);
+    void set_string(std::string_view id, std::string_view val);
+    void set_point(std::string_view id, int x, int y);
+    void set_rect(std::string_view id, int x, int y, int w, int h);
+    void set_int_array(std::string_view id, ccl_span<const int> values);
+    void set_float_array(std::string_view id, ccl_span<const float> values);
+private:
+    struct layer
+    {
+        ccl_config* config;
+        /* Revision of the config the index was built from */
+        uint64_t revision;
+    };
+
+    struct slot
+    {
+        uint64_t hash;
+        ccl_data* node;
+        size_t layer;
+    };
+
+    /* Rebuilds the index if any layer changed, true if it was current */
+    bool update();
+    void rebuild();
+    slot* find(std::string_view id, uint64_t hash);
+    template <class T>
+    T get_value(std::string_view id);
+    /* Calls store(node) on the node of id in the write layer */
+    template <class F>
+    void set_value(std::string_view id, data_type type, F&& store);
+
+    std::vector<layer> m_layers_;
+    size_t m_write_layer_ = 0;
+    std::vector<slot> m_slots_;
 };
 
 #ifdef _MSC_VER
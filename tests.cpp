@@ -0,0 +1,734 @@
+#include "ccl.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+/**
+ * This file is part of CCL which is licenced under
+ * the MIT licence (See LICENCE)
+ * github.com/univrsal/ccl
+ */
+
+/*
+   Tests for CCL, run by ctest
+   Files are created in the working directory and removed again.
+   Pass test names to only run those
+*/
+
+static int failures = 0;
+
+#define CHECK(expr) \
+    do \
+    { \
+        if (!(expr)) \
+        { \
+            fprintf(stderr, "%s:%i: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            failures++; \
+        } \
+    } while (0)
+
+static void write_text(const std::string& path, const std::string& text)
+{
+    const auto f = fopen(path.c_str(), "wb");
+    if (f)
+    {
+        fwrite(text.data(), 1, text.length(), f);
+        fclose(f);
+    }
+}
+
+static std::string read_text(const std::string& path)
+{
+    std::string text;
+    const auto f = fopen(path.c_str(), "rb");
+    if (f)
+    {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            text.append(buf, n);
+        fclose(f);
+    }
+    return text;
+}
+
+static bool file_exists(const std::string& path)
+{
+    const auto f = fopen(path.c_str(), "rb");
+    if (f)
+        fclose(f);
+    return f != nullptr;
+}
+
+/* Deletes a config file and everything ccl keeps next to it */
+static void remove_files(const std::string& path)
+{
+    remove(path.c_str());
+    remove((path + ".journal").c_str());
+    remove((path + ".cclb").c_str());
+}
+
+/* Modification times can be too coarse to tell writes apart */
+static void wait_for_new_mtime()
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+static bool has_error(const ccl_config& cfg, const error_code code)
+{
+    for (size_t i = 0; cfg.get_error(i); i++)
+    {
+        if (cfg.get_error(i)->code == code)
+            return true;
+    }
+    return false;
+}
+
+static void add_all_types(ccl_config& cfg)
+{
+    const int ints[] = { 1, -2, 2147483647 };
+    const float floats[] = { 0.5f, -1e-7f, 3.25f };
+    cfg.add_int("int", "An int", -1234);
+    cfg.add_float("float", "A float", 0.1f);
+    cfg.add_int64("int64", "", -9007199254740993ll);
+    cfg.add_double("double", "A double", 0.1 + 0.2);
+    cfg.add_bool("bool", "A bool", true);
+    cfg.add_string("string", "Two lines", "first\nsecond = x");
+    cfg.add_point("point", "A point", 235, -293);
+    cfg.add_rect("rect", "A rect", 224, -342, 1233, 12);
+    cfg.add_int_array("ints", "Some ints", ints);
+    cfg.add_float_array("floats", "", floats);
+}
+
+static void check_all_types(ccl_config& cfg)
+{
+    CHECK(cfg.get_int("int") == -1234);
+    CHECK(cfg.get_float("float") == 0.1f);
+    CHECK(cfg.get_int64("int64") == -9007199254740993ll);
+    CHECK(cfg.get_double("double") == 0.1 + 0.2);
+    CHECK(cfg.get_bool("bool"));
+    CHECK(cfg.get_string("string") == "first\nsecond = x");
+    CHECK(cfg.get_point("point").x == 235 && cfg.get_point("point").y == -293);
+    const auto r = cfg.get_rect("rect");
+    CHECK(r.x == 224 && r.y == -342 && r.w == 1233 && r.h == 12);
+    const auto ints = cfg.get_int_array("ints");
+    CHECK(ints.size() == 3 && ints[0] == 1 && ints[1] == -2 && ints[2] == 2147483647);
+    const auto floats = cfg.get_float_array("floats");
+    CHECK(floats.size() == 3 && floats[0] == 0.5f && floats[1] == -1e-7f && floats[2] == 3.25f);
+    CHECK(cfg.get_node("int")->get_comment() == "An int");
+    CHECK(cfg.get_node("string")->get_comment() == "Two lines");
+    CHECK(cfg.get_node("int64")->get_comment().empty());
+}
+
+static void test_round_trip()
+{
+    const std::string path = "ccl_tests_round_trip.ini";
+    remove_files(path);
+    {
+        ccl_config cfg(path, "round trip");
+        CHECK(cfg.is_empty());
+        add_all_types(cfg);
+        check_all_types(cfg);
+        cfg.write();
+    }
+
+    for (const unsigned flags : { ccl_load_default, ccl_load_mapped, ccl_load_lazy, ccl_load_intern })
+    {
+        ccl_config cfg(path, "", flags);
+        CHECK(!cfg.is_empty());
+        CHECK(!cfg.has_errors());
+        check_all_types(cfg);
+    }
+
+    /* Each load and write reverses the entry order, two give the same file */
+    const auto text = read_text(path);
+    for (auto i = 0; i < 2; i++)
+    {
+        ccl_config cfg(path, "");
+        cfg.write();
+    }
+    CHECK(read_text(path) == text);
+    CHECK(text.compare(0, 13, "# round trip\n") == 0);
+    remove_files(path);
+}
+
+static void test_invalid_lines()
+{
+    const std::string path = "ccl_tests_invalid.ini";
+    write_text(path, "# header\n0_a=5\n0_bad=abc\nx_what=1\n0_noeq\n\n1_s=text\n");
+    ccl_config cfg(path, "");
+    CHECK(cfg.get_int("a") == 5);
+    CHECK(cfg.get_string("s") == "text");
+    CHECK(has_error(cfg, ccl_error_invalid_value));
+    CHECK(has_error(cfg, ccl_error_invalid_type));
+    CHECK(has_error(cfg, ccl_error_missing_separator));
+
+    /* Missing and mismatched entries */
+    const auto count = cfg.get_error_count();
+    CHECK(cfg.get_int("nope", true) == 0);
+    CHECK(cfg.get_float("a", true) == 0.f);
+    CHECK(cfg.get_error_count() == count);
+    cfg.get_float("a");
+    CHECK(cfg.get_error_count() == count + 1 && cfg.get_error(0)->code == ccl_error_get);
+    remove_files(path);
+}
+
+static void test_journal()
+{
+    const std::string path = "ccl_tests_journal.ini";
+    remove_files(path);
+    {
+        ccl_config cfg(path, "journal");
+        cfg.add_int("a", "Value a", 1);
+        cfg.add_string("s", "", "old");
+        cfg.write();
+    }
+    const auto text = read_text(path);
+
+    {
+        ccl_config cfg(path, "", ccl_load_journal);
+        cfg.set_int("a", 2);
+        cfg.set_string("s", "new\nline");
+        cfg.add_int("b", "Value b", 3);
+    }
+    /* Changes only went to the journal */
+    CHECK(read_text(path) == text);
+    CHECK(file_exists(path + ".journal"));
+
+    {
+        ccl_config cfg(path, "", ccl_load_journal);
+        CHECK(cfg.get_int("a") == 2);
+        CHECK(cfg.get_string("s") == "new\nline");
+        CHECK(cfg.get_int("b") == 3);
+        CHECK(cfg.get_node("a")->get_comment() == "Value a");
+        CHECK(cfg.get_node("b")->get_comment() == "Value b");
+        cfg.compact();
+    }
+    CHECK(read_text(path + ".journal").empty());
+
+    /* Everything is in the file itself now */
+    ccl_config cfg(path, "");
+    CHECK(cfg.get_int("a") == 2);
+    CHECK(cfg.get_string("s") == "new\nline");
+    CHECK(cfg.get_int("b") == 3);
+
+    /* A record cut off while appending is dropped */
+    write_text(path + ".journal", "0_a=7\n0_b=8");
+    ccl_config cut(path, "", ccl_load_journal);
+    CHECK(cut.get_int("a") == 7);
+    CHECK(cut.get_int("b") == 3);
+    remove_files(path);
+}
+
+static void test_cache()
+{
+    const std::string path = "ccl_tests_cache.ini";
+    remove_files(path);
+    {
+        ccl_config cfg(path, "cache");
+        add_all_types(cfg);
+        cfg.write();
+    }
+
+    {
+        ccl_config cfg(path, "", ccl_load_cache);
+        check_all_types(cfg);
+        CHECK(cfg.get_stats().entries_parsed > 0);
+    }
+    CHECK(file_exists(path + ".cclb"));
+
+    /* Loaded from the cache without parsing */
+    for (const unsigned flags : { unsigned(ccl_load_cache), unsigned(ccl_load_cache | ccl_load_lazy) })
+    {
+        ccl_config cfg(path, "", flags);
+        CHECK(cfg.get_stats().entries_parsed == 0);
+        check_all_types(cfg);
+    }
+
+    /* Changing the file makes it parse the text again */
+    wait_for_new_mtime();
+    {
+        ccl_config cfg(path, "");
+        cfg.set_int("int", 99);
+        cfg.write();
+    }
+    {
+        ccl_config cfg(path, "", ccl_load_cache);
+        CHECK(cfg.get_stats().entries_parsed > 0);
+        CHECK(cfg.get_int("int") == 99);
+    }
+    {
+        ccl_config cfg(path, "", ccl_load_cache);
+        CHECK(cfg.get_stats().entries_parsed == 0);
+        CHECK(cfg.get_int("int") == 99);
+    }
+
+    /* Caches without comments aren't used by loads that keep them */
+    {
+        ccl_config cfg(path, "", ccl_load_cache | ccl_load_no_comments);
+        CHECK(cfg.get_stats().entries_parsed > 0);
+        CHECK(cfg.get_node("int")->get_comment().empty());
+    }
+    {
+        ccl_config cfg(path, "", ccl_load_cache | ccl_load_no_comments);
+        CHECK(cfg.get_stats().entries_parsed == 0);
+    }
+    {
+        ccl_config cfg(path, "", ccl_load_cache);
+        CHECK(cfg.get_stats().entries_parsed > 0);
+        CHECK(cfg.get_node("int")->get_comment() == "An int");
+        cfg.write();
+    }
+    CHECK(read_text(path).find("# An int\n") != std::string::npos);
+
+    /* Broken caches are ignored */
+    write_text(path + ".cclb", "CCLB garbage");
+    {
+        ccl_config cfg(path, "", ccl_load_cache);
+        CHECK(cfg.get_int("int") == 99);
+        CHECK(!cfg.has_errors());
+    }
+    remove_files(path);
+}
+
+static void test_watch()
+{
+#ifdef __linux__
+    const std::string path = "ccl_tests_watch.ini";
+    remove_files(path);
+    write_text(path, "# watch\n# Value a\n0_a=1\n0_b=2\n1_c=gone\n");
+
+    ccl_config cfg(path, "");
+    CHECK(cfg.watch(true));
+    const auto b = cfg.get_node("b");
+    CHECK(!cfg.poll_changes());
+
+    wait_for_new_mtime();
+    write_text(path, "# watch\n# Value a\n0_a=10\n0_b=2\n0_d=4\n");
+    CHECK(cfg.poll_changes());
+    CHECK(cfg.get_int("a") == 10);
+    CHECK(cfg.get_node("a")->get_comment() == "Value a");
+    CHECK(cfg.get_int("d") == 4);
+    CHECK(!cfg.node_exists("c"));
+    /* Unchanged entries keep their node */
+    CHECK(cfg.get_node("b") == b);
+
+    /* Own writes aren't reported as changes */
+    cfg.set_int("b", 20);
+    cfg.write();
+    CHECK(!cfg.poll_changes());
+
+    wait_for_new_mtime();
+    write_text(path, read_text(path) + "0_e=5\n");
+    CHECK(cfg.poll_changes());
+    CHECK(cfg.get_int("b") == 20);
+    CHECK(cfg.get_int("e") == 5);
+    CHECK(!has_error(cfg, ccl_error_exists));
+    cfg.watch(false);
+
+    /* Writing before watching starts */
+    ccl_config other(path, "");
+    other.add_int("n", "", 5);
+    other.write();
+    CHECK(other.watch(true));
+    wait_for_new_mtime();
+    const auto text = read_text(path);
+    const auto pos = text.find("0_n=5");
+    CHECK(pos != std::string::npos);
+    write_text(path, text.substr(0, pos) + "0_n=6" + text.substr(pos + 5));
+    CHECK(other.poll_changes());
+    CHECK(other.get_int("n") == 6);
+    CHECK(!other.has_errors());
+    remove_files(path);
+#endif
+}
+
+static void test_parallel()
+{
+    /* Big enough to be split up if there are multiple cores */
+    const std::string path = "ccl_tests_parallel.ini";
+    std::string text = "# parallel\n";
+    for (auto i = 0; i < 150000; i++)
+    {
+        const auto n = std::to_string(i);
+        if (i % 3 == 0)
+            text += "# Comment " + n + "\n";
+        switch (i % 4)
+        {
+        case 0:
+            text += "0_key" + n + "=" + n + "\n";
+            break;
+        case 1:
+            text += "1_key" + n + "=line\\nvalue " + n + "\n";
+            break;
+        case 2:
+            text += "3_key" + n + "=" + n + ".5\n";
+            break;
+        default:
+            text += "8_key" + n + "=1,2," + n + "\n";
+            break;
+        }
+    }
+    write_text(path, text);
+
+    ccl_config serial(path, "");
+    ccl_config parallel(path, "", ccl_load_parallel);
+    CHECK(!serial.has_errors() && !parallel.has_errors());
+
+    auto a = serial.get_first();
+    auto b = parallel.get_first();
+    size_t count = 0;
+    for (; a && b; a = a->get_next(), b = b->get_next(), count++)
+    {
+        if (a->get_id_view() != b->get_id_view() || a->get_type() != b->get_type()
+            || a->get_value() != b->get_value() || a->get_comment_view() != b->get_comment_view())
+            break;
+    }
+    CHECK(!a && !b);
+    CHECK(count == 150000);
+    CHECK(parallel.get_node("key149999") != nullptr);
+    remove_files(path);
+}
+
+static void test_lazy()
+{
+    const std::string path = "ccl_tests_lazy.ini";
+    write_text(path, "# lazy\n0_a=5\n0_bad=abc\n1_s=x\\ny\n");
+
+    ccl_config cfg(path, "", ccl_load_lazy);
+    /* Invalid values are only found once they're read */
+    CHECK(!cfg.has_errors());
+    CHECK(cfg.get_int("a") == 5);
+    CHECK(cfg.get_string("s") == "x\ny");
+    CHECK(!cfg.has_errors());
+    /* Silent lookups don't report them */
+    CHECK(cfg.node_exists("bad"));
+    CHECK(cfg.get_node("bad", true));
+    CHECK(cfg.get_error_count() == 0);
+    CHECK(cfg.get_int("bad") == 0);
+    CHECK(has_error(cfg, ccl_error_invalid_value));
+    remove_files(path);
+}
+
+static void test_handles()
+{
+    ccl_config cfg;
+    cfg.add_int("a", "", 1);
+    cfg.add_string("s", "", "text");
+
+    auto a = cfg.handle<int>("a");
+    auto s = cfg.handle<std::string>("s");
+    const auto wrong = cfg.handle<float>("a");
+    CHECK(a.valid() && *a == 1);
+    CHECK(s.valid() && *s == "text");
+    CHECK(!wrong.valid() && *wrong == 0.f);
+
+    a = 2;
+    CHECK(cfg.get_int("a") == 2);
+
+    /* Deleting the entry invalidates the handle until it's added again */
+    CHECK(cfg.remove_prefix("a") == 1);
+    CHECK(!a.valid() && *a == 0);
+    CHECK(s.valid() && *s == "text");
+    cfg.add_int("a", "", 3);
+    CHECK(a.valid() && *a == 3);
+}
+
+static void test_layers()
+{
+    ccl_config defaults, site, user;
+    defaults.add_int("w", "Width", 640);
+    defaults.add_int("h", "Height", 480);
+    defaults.add_string("name", "", "defaults");
+    site.add_int("w", "", 800);
+    site.add_string("name", "", "site");
+    user.add_string("name", "", "user");
+
+    ccl_layered_config cfg;
+    cfg.add_layer(&defaults);
+    cfg.add_layer(&site);
+    cfg.add_layer(&user);
+    CHECK(cfg.get_int("w") == 800);
+    CHECK(cfg.get_int("h") == 480);
+    CHECK(cfg.get_string("name") == "user");
+    CHECK(cfg.get_owner("w") == 1);
+    CHECK(cfg.get_owner("nope") == -1);
+
+    /* Writes go to the top layer and copy the comment */
+    cfg.set_int("h", 1080);
+    CHECK(cfg.get_int("h") == 1080);
+    CHECK(cfg.get_owner("h") == 2);
+    CHECK(defaults.get_int("h") == 480);
+    CHECK(user.get_node("h")->get_comment() == "Height");
+
+    /* Lower layers changing is picked up */
+    site.add_int("x", "", 5);
+    CHECK(cfg.get_int("x") == 5);
+    user.free_nodes();
+    CHECK(cfg.get_string("name") == "site");
+    CHECK(cfg.get_int("h") == 480);
+}
+
+static void test_batch()
+{
+    ccl_config cfg;
+    cfg.add_int("w", "", 640);
+    cfg.add_double("scale", "", 1.5);
+    cfg.add_string("name", "", "hello");
+    cfg.add_rect("win", "", 1, 2, 3, 4);
+    cfg.add_int_array("lut", "", std::vector<int>{ 1, 2, 3 });
+    cfg.add_int("other", "", 3);
+
+    int w = 0;
+    double scale = 0;
+    std::string name;
+    ccl_rect win;
+    std::vector<int> lut;
+    float other = 7.f;
+    int missing = -1;
+    const ccl_binding bindings[] = { { "w", &w }, { "scale", &scale }, { "name", &name },
+        { "win", &win }, { "lut", &lut }, { "other", &other }, { "missing", &missing } };
+
+    auto result = cfg.get_batch(bindings, true);
+    CHECK(result.done == 5 && result.mismatched == 1 && result.missing == 1 && !result.ok());
+    CHECK(w == 640 && scale == 1.5 && name == "hello" && win.h == 4 && lut.size() == 3);
+    /* Failed targets are left alone */
+    CHECK(other == 7.f && missing == -1);
+    CHECK(!cfg.has_errors());
+
+    w = 800;
+    name = "bye";
+    lut = { 9 };
+    result = cfg.set_batch(bindings, 5);
+    CHECK(result.done == 5 && result.ok());
+    CHECK(cfg.get_int("w") == 800 && cfg.get_string("name") == "bye");
+    CHECK(cfg.get_int_array("lut").size() == 1 && cfg.get_int_array("lut")[0] == 9);
+
+    cfg.get_batch(bindings);
+    CHECK(has_error(cfg, ccl_error_batch_get));
+}
+
+static void test_sections()
+{
+    ccl_config cfg;
+    cfg.add_int("render.w", "", 640);
+    cfg.add_int("render.h", "", 480);
+    cfg.add_bool("render.shadow.enabled", "", true);
+    cfg.add_int("renderer", "", 1);
+    cfg.add_string("net.host", "", "localhost");
+    cfg.add_int("a", "", 1);
+
+    auto render = cfg.section("render");
+    CHECK(render.get_int("w") == 640);
+    CHECK(render.section("shadow").get_bool("enabled"));
+    CHECK(render.count() == 3);
+    CHECK(cfg.count_prefix("render") == 4);
+    CHECK(cfg.count_prefix("") == 6);
+    CHECK(cfg.count_prefix("zzz") == 0);
+
+    /* Sorted by identifier */
+    std::vector<std::string> ids;
+    for (const auto node : render.entries())
+        ids.push_back(node->get_id());
+    CHECK((ids == std::vector<std::string>{ "render.h", "render.shadow.enabled", "render.w" }));
+
+    render.set_int("w", 1024);
+    CHECK(cfg.get_int("render.w") == 1024);
+    cfg.add_int("render.x", "", 5);
+    CHECK(render.count() == 4);
+
+    CHECK(render.remove() == 4);
+    CHECK(!cfg.node_exists("render.w"));
+    CHECK(cfg.get_int("renderer") == 1);
+    CHECK(cfg.count_prefix("") == 3);
+
+    /* The order is kept up to date between queries */
+    for (auto i = 0; i < 500; i++)
+    {
+        cfg.add_int("k." + std::to_string(i * 7919 % 500), "", i);
+        if (i % 3 == 0)
+            cfg.remove_prefix("k." + std::to_string(i * 31 % 500));
+        cfg.count_prefix("k.");
+    }
+    const auto all = cfg.get_prefix("");
+    auto sorted = true;
+    size_t count = 0;
+    for (auto it = all.begin(); it != all.end(); ++it, count++)
+    {
+        if (it + 1 != all.end() && (*it)->get_id() >= (*(it + 1))->get_id())
+            sorted = false;
+        if (cfg.get_node((*it)->get_id(), true) != *it)
+            sorted = false;
+    }
+    CHECK(sorted);
+    auto listed = 0;
+    for (auto node = cfg.get_first(); node; node = node->get_next())
+        listed++;
+    CHECK(count == static_cast<size_t>(listed));
+}
+
+static void test_stats()
+{
+    ccl_config cfg;
+    cfg.add_int("a", "", 1);
+    cfg.add_string("s", "", "x");
+    cfg.reset_stats();
+
+    cfg.get_int("a");
+    cfg.get_int("a");
+    cfg.get_int("nope", true);
+    cfg.get_float("a", true);
+    cfg.get_string("s");
+
+    auto stats = cfg.get_stats();
+#ifndef CCL_NO_STATS
+    CHECK(stats.lookups == 5);
+    CHECK(stats.lookup_misses == 1);
+    CHECK(stats.get_hits[ccl_type_int] == 2);
+    CHECK(stats.get_misses[ccl_type_int] == 1);
+    CHECK(stats.get_misses[ccl_type_float] == 1);
+    CHECK(stats.type_mismatches == 1);
+    CHECK(stats.get_hits[ccl_type_string] == 1);
+#endif
+
+    int a = 0;
+    const ccl_binding bindings[] = { { "a", &a }, { "nope", &a } };
+    cfg.get_batch(bindings, true);
+    stats = cfg.get_stats();
+#ifndef CCL_NO_STATS
+    CHECK(stats.lookups == 7);
+    CHECK(stats.get_hits[ccl_type_int] == 3);
+    CHECK(stats.get_misses[ccl_type_int] == 2);
+#endif
+
+    cfg.reset_stats();
+    stats = cfg.get_stats();
+    CHECK(stats.lookups == 0 && stats.get_hits[ccl_type_int] == 0);
+}
+
+static void test_arrays()
+{
+    const std::string path = "ccl_tests_arrays.ini";
+    write_text(path, "# arrays\n8_lut=0, 1,4 ,-9\n9_w=0.5,1e10,-3e-5\n8_empty=\n8_bad=1,x\n");
+
+    ccl_config cfg(path, "");
+    const auto lut = cfg.get_int_array("lut");
+    CHECK(lut.size() == 4 && lut[2] == 4 && lut[3] == -9);
+    const auto w = cfg.get_float_array("w");
+    CHECK(w.size() == 3 && w[1] == 1e10f && w[2] == -3e-5f);
+    CHECK(cfg.get_int_array("empty").empty());
+    CHECK(has_error(cfg, ccl_error_invalid_value));
+
+    int values[4] = { 5, 6, 7, 8 };
+    cfg.set_int_array("lut", values);
+    CHECK(cfg.get_int_array("lut").size() == 4 && cfg.get_int_array("lut")[3] == 8);
+    CHECK(cfg.get_node("lut")->get_value() == "5,6,7,8");
+
+    /* Setting the same array again reuses its memory */
+    const auto usage = cfg.memory_usage().total;
+    for (auto i = 0; i < 1000; i++)
+        cfg.set_int_array("lut", values);
+    CHECK(cfg.memory_usage().total == usage);
+
+    cfg.write();
+    ccl_config loaded(path, "");
+    CHECK(loaded.get_int_array("lut").size() == 4 && loaded.get_int_array("lut")[0] == 5);
+    CHECK(loaded.get_float_array("w").size() == 3);
+    remove_files(path);
+}
+
+static void test_memory_reuse()
+{
+    ccl_config cfg;
+    cfg.add_string("s", "", "");
+    size_t usage = 0;
+    for (auto i = 0; i < 5000; i++)
+    {
+        cfg.set_string("s", std::string(1 + i % 300, 'x'));
+        cfg.add_string("tmp", "comment", std::string(i % 100, 'y'));
+        cfg.remove_prefix("tmp");
+        if (i == 1000)
+            usage = cfg.memory_usage().total;
+    }
+    CHECK(cfg.get_string("s").size() == 1 + 4999 % 300);
+    CHECK(cfg.memory_usage().total == usage);
+}
+
+static void test_snapshots()
+{
+    ccl_config cfg;
+    cfg.add_int("n", "", 0);
+    cfg.publish();
+
+    std::vector<std::thread> readers;
+    auto errors = 0;
+    for (auto t = 0; t < 4; t++)
+    {
+        readers.emplace_back([&cfg, &errors]
+        {
+            auto last = 0;
+            for (auto i = 0; i < 20000; i++)
+            {
+                const auto snapshot = cfg.snapshot();
+                const auto n = snapshot->get_int("n");
+                /* Published versions only go forward */
+                if (n < last)
+                    errors++;
+                last = n;
+            }
+        });
+    }
+    for (auto i = 1; i <= 1000; i++)
+    {
+        cfg.set_int("n", i);
+        cfg.publish();
+    }
+    for (auto& t : readers)
+        t.join();
+    CHECK(errors == 0);
+    CHECK(cfg.snapshot()->get_int("n") == 1000);
+}
+
+struct test_case
+{
+    const char* name;
+    void (*run)();
+};
+
+static const test_case tests[] = {
+    { "round_trip", test_round_trip },
+    { "invalid_lines", test_invalid_lines },
+    { "journal", test_journal },
+    { "cache", test_cache },
+    { "watch", test_watch },
+    { "parallel", test_parallel },
+    { "lazy", test_lazy },
+    { "handles", test_handles },
+    { "layers", test_layers },
+    { "batch", test_batch },
+    { "sections", test_sections },
+    { "stats", test_stats },
+    { "arrays", test_arrays },
+    { "memory_reuse", test_memory_reuse },
+    { "snapshots", test_snapshots },
+};
+
+int main(int argc, char** argv)
+{
+    for (const auto& test : tests)
+    {
+        auto selected = argc < 2;
+        for (auto i = 1; i < argc; i++)
+            selected |= strcmp(argv[i], test.name) == 0;
+        if (!selected)
+            continue;
+
+        const auto before = failures;
+        test.run();
+        printf("%s %s\n", failures == before ? "passed" : "FAILED", test.name);
+    }
+    return failures == 0 ? 0 : 1;
+}